@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include "function.hpp"
+
+// Finding a window that shows an equation's curve (see :autofit).
+// Windows around the current one's center are searched for sign changes, each solved at 256x256
+// points: first the current window, then ones 4, 16, 64... times as wide, then (if nothing was found
+// far out) ones 4, 16, 64... times narrower, for small curves. The first window with any sign change
+// is kept, and the new window is fitted around the points where the sign changes.
+// Each window's columns are split into chunks, solved by as many threads as there are, and the search
+// stops when its time is up.
+
+// Where an equation's sign changed in a search
+struct Bounds {
+    double startX{ INFINITY };
+    double endX{ -INFINITY };
+    double startY{ INFINITY };
+    double endY{ -INFINITY };
+    std::size_t found{ 0 };
+
+    void add(double x, double y) {
+        startX = std::min(startX, x);
+        endX = std::max(endX, x);
+        startY = std::min(startY, y);
+        endY = std::max(endY, y);
+        found++;
+    }
+    void add(const Bounds& other) {
+        startX = std::min(startX, other.startX);
+        endX = std::max(endX, other.endX);
+        startY = std::min(startY, other.startY);
+        endY = std::max(endY, other.endY);
+        found += other.found;
+    }
+};
+
+// Moves and scales window to show bounds, with a tenth more on every side and the bounds at least
+// smallest across. The window keeps its number of columns and rows, and the shape of its cells
+inline void fitWindow(Grid& window, const Bounds& bounds, double smallest) {
+    const int columns{ gridColumns(window) };
+    const int rows{ gridRows(window) };
+    double width{ std::max(bounds.endX - bounds.startX, smallest) * 1.2 };
+    double height{ std::max(bounds.endY - bounds.startY, smallest) * 1.2 };
+    double shape{ window.stepY / window.stepX };
+    double middleX{ (bounds.startX + bounds.endX) / 2 };
+    double middleY{ (bounds.startY + bounds.endY) / 2 };
+    window.stepX = std::max(width / (columns - 1), height / (rows - 1) / shape);
+    window.stepY = window.stepX * shape;
+    window.startX = middleX - window.stepX * (columns - 1) / 2;
+    window.endX = middleX + window.stepX * (columns - 1) / 2;
+    window.startY = middleY - window.stepY * (rows - 1) / 2;
+    window.endY = middleY + window.stepY * (rows - 1) / 2;
+}
+
+// Looks for sign changes of a compiled equation over a window (settings' start and end), solved at
+// samples x samples points. Returns false if time ran out first. solved counts the points solved
+inline bool findSignChanges(const Program& program, const Grid& settings, int samples, unsigned int threads,
+    std::chrono::steady_clock::time_point deadline, Bounds& bounds, std::size_t& solved) {
+    const double stepX{ (settings.endX - settings.startX) / (samples - 1) };
+    const double stepY{ (settings.endY - settings.startY) / (samples - 1) };
+    const int chunk{ 16 };
+    const int chunks{ (samples - 1 + chunk-1) / chunk };
+    std::atomic<int> next{ 0 };
+    std::atomic<bool> late{ false };
+    std::atomic<std::size_t> points{ 0 };
+    std::mutex mutex{ };
+
+    auto work{ [&] {
+        Bounds local{ };
+        while (true) {
+            int c{ next++ };
+            if (c >= chunks) break;
+            if (std::chrono::steady_clock::now() > deadline) {
+                late = true;
+                break;
+            }
+            // One more column than the chunk, for the sign changes between it and the next
+            Grid part{ settings };
+            part.mode = m::equation;
+            part.precision = p::exact;
+            part.stepX = stepX;
+            part.stepY = stepY;
+            part.startX = settings.startX + c*chunk*stepX;
+            part.endX = settings.startX + std::min(samples - 1, (c+1)*chunk)*stepX + stepX/2;
+            part.endY = settings.startY + (samples - 1)*stepY + stepY/2;
+            const Grid values{ std::move(createOverlay(program, part).at(0)) };
+            points += values.points.size() * samples;
+
+            auto change{ [](double a, double b) { return std::isfinite(a) && std::isfinite(b) && (a < 0) != (b < 0); } };
+            for (std::size_t x{ 0 }; x < values.points.size(); x++) {
+                const std::vector<double>& column{ values.points[x] };
+                double actualX{ part.startX + x*stepX };
+                for (std::size_t y{ 0 }; y < column.size(); y++) {
+                    double actualY{ part.startY + y*stepY };
+                    if (y+1 < column.size() && change(column[y], column[y+1])) local.add(actualX, actualY + stepY/2);
+                    if (x+1 < values.points.size() && change(column[y], values.points[x+1][y])) local.add(actualX + stepX/2, actualY);
+                }
+            }
+        }
+        std::lock_guard lock{ mutex };
+        bounds.add(local);
+    } };
+    std::vector<std::thread> workers{ };
+    for (unsigned int i{ 1 }; i < threads; i++) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+    solved += points;
+    return !late;
+}
+
+// Fits window (keeping its number of columns and rows, and the shape of its cells) around where a
+// compiled equation's curve is, searching for at most seconds. threads is 0 for one per core.
+// Returns false (leaving window as it was) if no curve was found in time. solved counts the points solved
+inline bool autofitWindow(const Program& program, Grid& window, double seconds, unsigned int threads, std::size_t& solved) {
+    const int samples{ 256 };
+    const double centerX{ (window.startX + window.endX) / 2 };
+    const double centerY{ (window.startY + window.endY) / 2 };
+    const double halfWidth{ (window.endX - window.startX) / 2 };
+    const double halfHeight{ (window.endY - window.startY) / 2 };
+    auto deadline{ std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds)) };
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<int> levels{ 0, 1, 2, 3, 4, 5, 6, 7, 8, -1, -2, -3, -4, -5, -6, -7, -8 };
+    Bounds bounds{ };
+    double sample{ };
+    for (const int level : levels) {
+        double scale{ std::pow(4.0, level) };
+        Grid search{ window };
+        search.startX = centerX - halfWidth*scale;
+        search.endX = centerX + halfWidth*scale;
+        search.startY = centerY - halfHeight*scale;
+        search.endY = centerY + halfHeight*scale;
+        bool finished{ findSignChanges(program, search, samples, threads, deadline, bounds, solved) };
+        sample = std::max(search.endX - search.startX, search.endY - search.startY) / (samples - 1);
+        if (bounds.found > 0 || !finished) break;
+    }
+    if (bounds.found == 0) return false;
+
+    // At least a few samples across
+    fitWindow(window, bounds, 4*sample);
+    return true;
+}
+
+// Fits window around a parametric or polar curve (compiled as for createParametric), from
+// 4096 points evenly spaced over t. Returns false if none of them were finite
+inline bool autofitCurve(const Program& program, Grid& window, std::size_t& solved) {
+    std::vector<double> ts{ };
+    for (int i{ 0 }; i <= 4096; i++) ts.push_back(window.startT + (window.endT - window.startT) * i / 4096);
+    Bounds bounds{ };
+    for (const CurvePoint& point : solveCurvePoints(program, window, ts)) {
+        if (std::isfinite(point.x) && std::isfinite(point.y)) bounds.add(point.x, point.y);
+    }
+    solved += ts.size();
+    if (bounds.found == 0) return false;
+
+    fitWindow(window, bounds, 1e-9);
+    return true;
+}
@@ -0,0 +1,304 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include "solve.hpp"
+#include "fastmath.hpp"
+
+// Values for the variables a-z, indexed by letter (variables['x'-'a']).
+// Unbound variables are 0, same as solveTree.
+using Variables = std::array<double, 26>;
+
+// One step of a compiled Program.
+// Operands are indices of earlier instructions (-1 = no operand, which is 0),
+// so running the instructions in order always has its operands ready.
+struct Instruction {
+    o operation{ o::none };
+    f function{ f::none };
+    bool isVariable{ false };
+    char variable{ '&' };
+    double value{ 0 };
+    int left{ -1 };
+    int right{ -1 };
+    unsigned int reads{ 0 }; // variables this instruction depends on, see varBit
+};
+
+// Bit for a variable in Instruction::reads
+inline unsigned int varBit(char variable) {
+    return 1u << (variable - 'a');
+}
+
+// A flattened form of one or more trees. Identical subtrees
+// (within one tree or between trees) are only compiled once.
+struct Program {
+    std::vector<Instruction> code{ };
+    std::vector<int> roots{ }; // result instruction for each compiled tree
+};
+
+// Same as solveOperation, without looking up the function's name (and never prints)
+inline double solveInstruction(const Instruction& ins, double left, double right) {
+    switch (ins.operation) {
+        case o::function: return doFunction(ins.function, left, right);
+        case o::none: return right;
+        default: return solveOperation(ins.operation, left, right);
+    }
+}
+
+// Instructions already in a program, see addInstruction. Values are compared by their bits, so NaN
+// (which isn't equal to anything, itself included) and -0 aren't mixed up with other constants
+using Seen = std::map<std::tuple<o, f, bool, char, std::uint64_t, int, int>, int>;
+
+// Adds an instruction to the program, or returns the identical one already in it
+inline int addInstruction(Program& program, const Instruction& ins, Seen& seen) {
+    auto key{ std::make_tuple(ins.operation, ins.function, ins.isVariable, ins.variable,
+        std::bit_cast<std::uint64_t>(ins.value), ins.left, ins.right) };
+    auto found{ seen.find(key) };
+    if (found != seen.end()) return found->second;
+
+    program.code.push_back(ins);
+    Instruction& added{ program.code.back() };
+    if (added.isVariable) added.reads = varBit(added.variable);
+    if (added.left != -1) added.reads |= program.code.at(added.left).reads;
+    if (added.right != -1) added.reads |= program.code.at(added.right).reads;
+    seen.insert({ key, (int)program.code.size()-1 });
+    return (int)program.code.size()-1;
+}
+
+inline int compileItem(const TreeItem& item, Program& program, Seen& seen, std::ostream& log) {
+    Instruction ins{ };
+    if (item.solved) {
+        ins.value = item.value;
+        return addInstruction(program, ins, seen);
+    }
+    if (item.isVariable) {
+        ins.isVariable = true;
+        ins.variable = item.variable;
+        // Only a-z can be bound, anything else is always 0 (same as solveTree)
+        if (item.variable < 'a' || item.variable > 'z') {
+            ins = { };
+        }
+        return addInstruction(program, ins, seen);
+    }
+    if (item.operation == o::none) {
+        // Nothing to solve, solveTree treats these as 0
+        return addInstruction(program, ins, seen);
+    }
+
+    ins.operation = item.operation;
+    if (item.operation == o::function) {
+        ins.function = fFromString(item.function);
+        if (ins.function == f::none) {
+            log << "<?> [compileItem:0] Unknown function " << item.function << ", using 0\n";
+            return addInstruction(program, { }, seen);
+        }
+    }
+    // Right first, same order as solveTree
+    if (item.right != nullptr) ins.right = compileItem(*item.right, program, seen, log);
+    if (item.left != nullptr) ins.left = compileItem(*item.left, program, seen, log);
+
+    // Fold operations on constants right away
+    auto isConstant{ [&](int i) {
+        return i == -1 || (program.code.at(i).operation == o::none && !program.code.at(i).isVariable);
+    } };
+    if (isConstant(ins.left) && isConstant(ins.right)) {
+        Instruction folded{ };
+        folded.value = solveInstruction(ins,
+            ins.left == -1 ? 0 : program.code.at(ins.left).value,
+            ins.right == -1 ? 0 : program.code.at(ins.right).value);
+        return addInstruction(program, folded, seen);
+    }
+    return addInstruction(program, ins, seen);
+}
+
+// Compiles several trees into one program so they can be solved together.
+// program.roots.at(i) is the result of trees.at(i). Warnings (unknown functions) are written to log
+inline Program compileTrees(const std::vector<TreeItem>& trees, std::ostream& log = std::cout) {
+    Program program{ };
+    Seen seen{ };
+    for (const TreeItem& tree : trees) {
+        program.roots.push_back(compileItem(tree, program, seen, log));
+    }
+    return program;
+}
+inline Program compileTree(const TreeItem& tree, std::ostream& log = std::cout) {
+    return compileTrees({ tree }, log);
+}
+
+// Runs every instruction of the program. registers must be program.code.size() long
+// and afterwards holds the value of each instruction (registers.at(program.roots.at(i)) for results).
+inline void solveProgram(const Program& program, const Variables& variables, std::vector<double>& registers) {
+    for (std::size_t i{ 0 }; i < program.code.size(); i++) {
+        const Instruction& ins{ program.code[i] };
+        if (ins.isVariable) {
+            registers[i] = variables[ins.variable - 'a'];
+        } else if (ins.operation == o::none) {
+            registers[i] = ins.value;
+        } else {
+            registers[i] = solveInstruction(ins,
+                ins.left == -1 ? 0 : registers[ins.left],
+                ins.right == -1 ? 0 : registers[ins.right]);
+        }
+    }
+}
+
+// Lanes for batch solving. lanes.at(i) holds instruction i's value in every lane,
+// or a single value if the instruction is the same in every lane.
+// Lanes are doubles, except for p::single grids, which solve in floats first (LanesOf<float>)
+template <typename T>
+using LanesOf = std::vector<std::vector<T>>;
+using Lanes = LanesOf<double>;
+
+// The values to batch-solve a program for
+struct Batch {
+    std::size_t size{ 1 }; // number of lanes
+    Variables variables{ }; // variables that are the same in every lane
+    std::map<char, std::vector<double>> varying{ }; // variables with a value per lane (size values each)
+    p precision{ p::exact };
+};
+
+// Applies op to every lane of left and right, where single-value operands are used for every lane
+template <typename T, typename Op>
+void lanewise(std::vector<T>& out, const std::vector<T>& left, const std::vector<T>& right, Op op) {
+    T* result{ out.data() };
+    const T* l{ left.data() };
+    const T* r{ right.data() };
+    std::size_t n{ out.size() };
+    if (left.size() == 1 && right.size() == 1) {
+        for (std::size_t i{ 0 }; i < n; i++) result[i] = op(l[0], r[0]);
+    } else if (left.size() == 1) {
+        T lv{ l[0] };
+        for (std::size_t i{ 0 }; i < n; i++) result[i] = op(lv, r[i]);
+    } else if (right.size() == 1) {
+        T rv{ r[0] };
+        for (std::size_t i{ 0 }; i < n; i++) result[i] = op(l[i], rv);
+    } else {
+        for (std::size_t i{ 0 }; i < n; i++) result[i] = op(l[i], r[i]);
+    }
+}
+
+// Solves a function with the fastmath.hpp kernels for every lane
+inline void fastFunctionLanes(f function, std::vector<double>& out, const std::vector<double>& left, const std::vector<double>& right) {
+    // One loop per function so each loop is just the kernel
+    switch(function) {
+        case f::sin:  lanewise(out, left, right, [](double, double r) { return fastSin(r); }); break;
+        case f::asin: lanewise(out, left, right, [](double, double r) { return fastAsin(r); }); break;
+        case f::cos:  lanewise(out, left, right, [](double, double r) { return fastCos(r); }); break;
+        case f::acos: lanewise(out, left, right, [](double, double r) { return fastAcos(r); }); break;
+        case f::tan:  lanewise(out, left, right, [](double, double r) { return fastTan(r); }); break;
+        case f::atan: lanewise(out, left, right, [](double, double r) { return fastAtan(r); }); break;
+        case f::sqrt: lanewise(out, left, right, [](double, double r) { return std::sqrt(r); }); break;
+        case f::cbrt: lanewise(out, left, right, [](double, double r) { return fastCbrt(r); }); break;
+        case f::log:  lanewise(out, left, right, [](double, double r) { return fastLog10(r); }); break;
+        case f::lb:   lanewise(out, left, right, [](double, double r) { return fastLog2(r); }); break;
+        case f::ln:   lanewise(out, left, right, [](double, double r) { return fastLog(r); }); break;
+        default:      lanewise(out, left, right, [&](double, double r) { return fastFunction(function, r); });
+    }
+}
+
+// Solves a function in single precision for every lane
+inline void singleFunctionLanes(f function, std::vector<float>& out, const std::vector<float>& left, const std::vector<float>& right) {
+    switch(function) {
+        case f::sin:  lanewise(out, left, right, [](float, float r) { return std::sin(r); }); break;
+        case f::asin: lanewise(out, left, right, [](float, float r) { return std::asin(r); }); break;
+        case f::cos:  lanewise(out, left, right, [](float, float r) { return std::cos(r); }); break;
+        case f::acos: lanewise(out, left, right, [](float, float r) { return std::acos(r); }); break;
+        case f::tan:  lanewise(out, left, right, [](float, float r) { return std::tan(r); }); break;
+        case f::atan: lanewise(out, left, right, [](float, float r) { return std::atan(r); }); break;
+        case f::sqrt: lanewise(out, left, right, [](float, float r) { return std::sqrt(r); }); break;
+        case f::cbrt: lanewise(out, left, right, [](float, float r) { return std::cbrt(r); }); break;
+        case f::log:  lanewise(out, left, right, [](float, float r) { return std::log10(r); }); break;
+        case f::lb:   lanewise(out, left, right, [](float, float r) { return std::log2(r); }); break;
+        case f::ln:   lanewise(out, left, right, [](float, float r) { return std::log(r); }); break;
+        default:      lanewise(out, left, right, [&](float, float r) { return (float)doFunction(function, 0, r); });
+    }
+}
+
+// Solves instruction i for every lane in the batch
+template <typename T>
+void solveLanes(const Program& program, std::size_t i, const Batch& batch, unsigned int varyingBits, LanesOf<T>& lanes) {
+    static const std::vector<T> zero{ 0 };
+    const Instruction& ins{ program.code[i] };
+    std::vector<T>& out{ lanes[i] };
+    out.resize((ins.reads & varyingBits) ? batch.size : 1);
+
+    if (ins.isVariable) {
+        auto found{ batch.varying.find(ins.variable) };
+        if (found != batch.varying.end()) out.assign(found->second.begin(), found->second.end());
+        else out[0] = (T)batch.variables[ins.variable - 'a'];
+        return;
+    } else if (ins.operation == o::none) {
+        out[0] = (T)ins.value;
+        return;
+    }
+    const std::vector<T>& left{ ins.left == -1 ? zero : lanes[ins.left] };
+    const std::vector<T>& right{ ins.right == -1 ? zero : lanes[ins.right] };
+
+    switch (ins.operation) {
+        case o::add:      lanewise(out, left, right, [](T l, T r) { return l + r; }); break;
+        case o::subtract: lanewise(out, left, right, [](T l, T r) { return l - r; }); break;
+        case o::negate:   lanewise(out, left, right, [](T, T r) { return -r; }); break;
+        case o::multiply: lanewise(out, left, right, [](T l, T r) { return l * r; }); break;
+        case o::divide:   lanewise(out, left, right, [](T l, T r) { return l / r; }); break;
+        case o::modulo:   lanewise(out, left, right, [](T l, T r) { return std::fmod(l, r); }); break;
+        case o::exponent:
+            if constexpr (std::is_same_v<T, double>) {
+                if (batch.precision == p::fast) {
+                    lanewise(out, left, right, [](double l, double r) { return fastPow(l, r); });
+                    break;
+                }
+            }
+            lanewise(out, left, right, [](T l, T r) { return std::pow(l, r); });
+            break;
+        case o::function:
+            if constexpr (std::is_same_v<T, double>) {
+                if (batch.precision == p::fast) fastFunctionLanes(ins.function, out, left, right);
+                else lanewise(out, left, right, [&](double l, double r) { return doFunction(ins.function, l, r); });
+            } else {
+                singleFunctionLanes(ins.function, out, left, right);
+            }
+            break;
+        default: lanewise(out, left, right, [&](T l, T r) { return (T)solveInstruction(ins, l, r); });
+    }
+}
+
+// Bits of the variables that change between lanes
+inline unsigned int varyingBits(const Batch& batch) {
+    unsigned int bits{ 0 };
+    for (const auto& [variable, values] : batch.varying) bits |= varBit(variable);
+    return bits;
+}
+
+// Solves the instructions of the program that `where(instruction)` is true for,
+// in order, for every lane in the batch. Other instructions keep their lanes.
+template <typename T, typename Where>
+void solveBatchWhere(const Program& program, const Batch& batch, LanesOf<T>& lanes, Where where) {
+    lanes.resize(program.code.size());
+    unsigned int bits{ varyingBits(batch) };
+    for (std::size_t i{ 0 }; i < program.code.size(); i++) {
+        if (where(program.code[i])) solveLanes(program, i, batch, bits, lanes);
+    }
+}
+
+// Solves every instruction of the program for every lane in the batch.
+// Instructions that don't read a varying variable are only solved once.
+template <typename T>
+void solveBatch(const Program& program, const Batch& batch, LanesOf<T>& lanes) {
+    solveBatchWhere(program, batch, lanes, [](const Instruction&) { return true; });
+}
+
+// Like solveBatch, but only re-solves the instructions that read one of the `changed` variables.
+// Everything else is kept from the last solveBatch with the same lanes.
+template <typename T>
+void resolveBatch(const Program& program, const Batch& batch, LanesOf<T>& lanes, unsigned int changed) {
+    solveBatchWhere(program, batch, lanes, [&](const Instruction& ins) { return (ins.reads & changed) != 0; });
+}
+
+// The value of a lane. Works for single-value lanes, too.
+template <typename T>
+T laneValue(const LanesOf<T>& lanes, int instruction, std::size_t lane) {
+    const std::vector<T>& values{ lanes[instruction] };
+    return values.size() == 1 ? values[0] : values[lane];
+}
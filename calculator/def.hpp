@@ -1,7 +1,10 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <limits>
+#include <cmath>
 
 enum class o {
     none,
@@ -14,6 +17,48 @@ enum class o {
     function,
     modulo
 };
+// Built-in functions, resolved from their names once
+// so evaluation never has to compare strings.
+enum class f {
+    none,
+    sin,
+    asin,
+    cos,
+    acos,
+    tan,
+    atan,
+    sqrt,
+    cbrt,
+    log,
+    lb,
+    ln,
+    abs,
+    sign,
+    even,
+    pi,
+    e
+};
+// Precision used to solve grids
+enum class p {
+    exact, // libm functions, full double precision
+    fast,  // fastmath.hpp approximations
+    single // floats, with points near 0 solved again in double precision
+};
+// What gets graphed
+enum class m {
+    equation, // 0 = ..., solved at every point of the grid
+    function, // y = f(x), solved a few times per column (see function.hpp)
+    parametric, // x = x(t), y = y(t), solved along the curve (see function.hpp)
+    polar // r = r(t), as parametric with x = r*COS(t), y = r*SIN(t)
+};
+// How m::equation graphs are found
+// e::grid is the default, since it's the only one whose Grid::points are the equation's values at each
+// point (the others give curve grids, see createCurve). The calculator itself uses e::roots
+enum class e {
+    roots, // solve polynomials in y column by column (see polynomial.hpp), and anything else as grid
+    grid, // solve every point and look for sign changes (see createGrid)
+    trace // follow the curve from a few points on it (see trace.hpp)
+};
 enum class t {
     none,
     group,
@@ -31,6 +76,17 @@ struct Token {
 };
 using TokenArr = std::vector<Token>;
 
+// A grid's signs packed into bits, for grids that are only drawn (see Grid::signs): 64 rows to a
+// word (bit y%64 of word y/64), column by column. Points exactly 0 are in both planes and NaN in
+// neither, so negating a point just swaps its bits
+struct SignPlanes {
+    int columns{ 0 };
+    int rows{ 0 };
+    int words{ 0 }; // per column
+    std::vector<std::uint64_t> nonNegative{ }; // >= 0
+    std::vector<std::uint64_t> nonPositive{ }; // <= 0
+};
+
 struct Grid {
     double startX{ -12 };
     double startY{ -8 };
@@ -38,7 +94,17 @@ struct Grid {
     double endY{ 8 };
     double stepX{ 0.25 }; // half b/c cmd characters are ~ half as wide as tall
     double stepY{ 0.5 };
+    p precision{ p::exact };
+    m mode{ m::equation };
+    e engine{ e::grid }; // m::equation only
+    double startT{ 0 }; // m::parametric and m::polar only: range of t
+    double endT{ 6.283185307179586 };
+    int sampleDepth{ 20 }; // m::function only: times a gap can be split, see createCurve
+    std::size_t sampleBudget{ 1 << 16 }; // m::function only: most values to solve
     std::vector<std::vector<double>> points{ };
+    std::size_t refined{ 0 }; // p::single only: points that had to be solved again in double precision
+    std::size_t solved{ 0 }; // m::function, m::parametric and m::polar only: values solved
+    SignPlanes signs{ }; // m::equation grids that are only drawn: the points' signs, with points left empty (see createOverlay)
 };
 
 // Unary (o::negate) operations
@@ -54,7 +120,7 @@ struct TreeItem {
     TreeItem* right{ nullptr };
 };
 
-std::string tAsString(t name) {
+inline std::string tAsString(t name) {
     switch(name) {
         case t::none: return "none";
         case t::group: return "group";
@@ -64,7 +130,7 @@ std::string tAsString(t name) {
         default: return "t?";
     }
 }
-std::string oAsString(o name) {
+inline std::string oAsString(o name) {
     switch(name) {
         case o::none: return "none";
         case o::add: return "add";
@@ -78,18 +144,72 @@ std::string oAsString(o name) {
         default: return "o?";
     }
 }
-void printToken(Token tk) {
-    std::cout << tAsString(tk.type) << "= " << oAsString(tk.operation) << ", " << tk.number << ", " << tk.variable << ", f" << tk.function << "\n";
+inline std::string pAsString(p name) {
+    switch(name) {
+        case p::exact: return "exact";
+        case p::fast: return "fast";
+        case p::single: return "float";
+        default: return "p?";
+    }
+}
+inline std::string mAsString(m name) {
+    switch(name) {
+        case m::equation: return "equation";
+        case m::function: return "function";
+        case m::parametric: return "parametric";
+        case m::polar: return "polar";
+        default: return "m?";
+    }
+}
+inline std::string eAsString(e name) {
+    switch(name) {
+        case e::roots: return "roots";
+        case e::grid: return "grid";
+        case e::trace: return "trace";
+        default: return "e?";
+    }
+}
+inline std::string fAsString(f name) {
+    switch(name) {
+        case f::none: return "none";
+        case f::sin: return "SIN";
+        case f::asin: return "ASIN";
+        case f::cos: return "COS";
+        case f::acos: return "ACOS";
+        case f::tan: return "TAN";
+        case f::atan: return "ATAN";
+        case f::sqrt: return "SQRT";
+        case f::cbrt: return "CBRT";
+        case f::log: return "LOG";
+        case f::lb: return "LB";
+        case f::ln: return "LN";
+        case f::abs: return "ABS";
+        case f::sign: return "SIGN";
+        case f::even: return "EVEN";
+        case f::pi: return "PI";
+        case f::e: return "E";
+        default: return "f?";
+    }
+}
+// Returns f::none for names that aren't built-in functions
+inline f fFromString(const std::string& name) {
+    for (int i{ 1 }; i <= (int)f::e; i++) {
+        if (fAsString((f)i) == name) return (f)i;
+    }
+    return f::none;
+}
+inline void printToken(Token tk, std::ostream& out = std::cout) {
+    out << tAsString(tk.type) << "= " << oAsString(tk.operation) << ", " << tk.number << ", " << tk.variable << ", f" << tk.function << "\n";
     if (tk.type == t::group) {
         for (const Token& child : tk.group) {
-           std::cout << "    ";
-           printToken(child);
+           out << "    ";
+           printToken(child, out);
         }
-        std::cout << "<-\n";
+        out << "<-\n";
     }
 }
 
-std::string getLine(std::string prompt) {
+inline std::string getLine(std::string prompt) {
     std::string input{ };
     // Prompt for input
     std::cout << prompt;
@@ -97,17 +217,19 @@ std::string getLine(std::string prompt) {
     return input;
 }
 // Clears anything waiting in the input buffer
-void clearCin() {
+inline void clearCin() {
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 }
 // Has the user enter a number
-double getNumber(std::string prompt) {
+inline double getNumber(std::string prompt) {
     double input{ };
     while (true) {
         // Prompt for input
         std::cout << prompt;
         std::cin >> input;
         
+        // Out of input (eg the end of a script), there's nothing to try again with
+        if (std::cin.fail() && std::cin.eof()) return std::nan("");
         // If failure, clear it and try again
         if (std::cin.fail()) {
             std::cin.clear();
@@ -0,0 +1,77 @@
+#pragma once
+#include <map>
+#include <regex>
+#include "tree.hpp"
+
+// A user-defined function (:def NAME(v) = ...): its equation, and the variable its argument is
+// bound to (0 if it doesn't take one). Bodies have already had other user functions inlined into them.
+struct Definition {
+    char parameter{ 0 };
+    TreeItem body{ };
+};
+// User-defined functions by name
+using Definitions = std::map<std::string, Definition>;
+
+// A copy of a tree with every use of a variable replaced by a copy of value
+inline TreeItem substituteVariable(const TreeItem& item, char variable, const TreeItem& value) {
+    if (item.isVariable && item.variable == variable) return copyTree(value);
+    TreeItem copy{ item };
+    if (item.left != nullptr) copy.left = new TreeItem{ substituteVariable(*item.left, variable, value) };
+    if (item.right != nullptr) copy.right = new TreeItem{ substituteVariable(*item.right, variable, value) };
+    return copy;
+}
+
+// Replaces every call to a user-defined function in the tree with a copy of its body, with the
+// call's argument in place of the parameter, so solving never has to look the name up.
+// A call without an argument (eg HYP()) passes 0, same as built-ins. Calling a function that doesn't
+// take an argument with one is an error (returns false and sets error).
+// Names that aren't defined are left alone (built-ins, or unknown functions)
+inline bool inlineFunctions(TreeItem& item, const Definitions& definitions, std::string& error) {
+    if (item.left != nullptr && !inlineFunctions(*item.left, definitions, error)) return false;
+    if (item.right != nullptr && !inlineFunctions(*item.right, definitions, error)) return false;
+    if (item.operation != o::function) return true;
+    auto found{ definitions.find(item.function) };
+    if (found == definitions.end()) return true;
+
+    const Definition& definition{ found->second };
+    TreeItem argument{ item.right != nullptr ? *item.right : TreeItem{ .solved = true } };
+    if (definition.parameter == 0) {
+        // () is parsed as 0, so that's all a call without an argument can have
+        if (!argument.solved || argument.value != 0) {
+            error = item.function + " doesn't take an argument, call it as " + item.function
+                + "() or define it with one (eg :def " + item.function + "(v) = ...)";
+            return false;
+        }
+        item = copyTree(definition.body);
+        return true;
+    }
+    item = substituteVariable(definition.body, definition.parameter, argument);
+    return true;
+}
+
+// Defines (or redefines) a function from text like "HYP = SQRT(x^2+y^2)" or "SQ(v) = v^2" (whose
+// argument is used for v). Equations and functions already using the old definition keep it.
+// Returns false and sets error if the definition can't be used.
+inline bool defineFunction(const std::string& definition, Definitions& definitions, std::string& error) {
+    const std::regex rDefinition{ "^ *([A-Z]+) *(\\( *([a-z]) *\\))? *= *(.+)$" };
+    std::smatch match;
+    if (!std::regex_search(definition, match, rDefinition)) {
+        error = "Definitions look like NAME = equation or NAME(v) = equation, where NAME is uppercase letters and v is a variable";
+        return false;
+    }
+    std::string name{ match.str(1) };
+    if (fFromString(name) != f::none) {
+        error = name + " is a built-in function";
+        return false;
+    }
+
+    Definition out{ .parameter = match[3].matched ? match.str(3)[0] : (char)0 };
+    if (!parseSource(match.str(4), out.body)) {
+        error = "Could not parse " + match.str(4);
+        return false;
+    }
+    // A function can't call itself, it isn't defined yet
+    if (!inlineFunctions(out.body, definitions, error)) return false;
+    definitions[name] = out;
+    return true;
+}
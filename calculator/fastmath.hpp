@@ -0,0 +1,198 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cmath>
+#include "def.hpp"
+
+// Fast approximations of the built-in functions, used when a grid's precision is p::fast.
+// They don't call libm and don't branch, so the batch loops using them can be vectorized.
+//
+// Error bounds (measured against libm, fastcheck.cpp checks them):
+//   fastSin, fastCos     absolute error < 1e-15 for |x| < 1e6, reduction error grows past that
+//   fastTan              relative error < 2e-15 for |x| < 1e6
+//   fastAtan             absolute error < 1e-10
+//   fastAsin, fastAcos   absolute error < 1e-10 (NaN outside -1..1)
+//   fastLog, fastLog2    error < 1e-15 * (1 + |result|) for x > 0
+//   fastExp2             relative error < 1e-15 (at most 2^-1074 off for subnormal results)
+//   fastPow              relative error < 5e-16 * (1 + |exponent * log2(|base|)|) for results within
+//                        1e-300..1e300, since the error of the log is scaled by the exponent. That's < 1e-14
+//                        for results within about 1e-6..1e6, and < 6e-13 at the ends of the range
+//   fastCbrt             relative error < 1e-13
+
+// Rounds to the nearest integer, for |x| < 2^51.
+// The low 32 bits of the integer are also given (no float to int conversion, so NaN is safe)
+inline double fastRound(double x, std::int32_t& low) {
+    const double magic{ 6755399441055744.0 }; // 2^52 + 2^51
+    double shifted{ x + magic };
+    low = (std::int32_t)(std::uint32_t)std::bit_cast<std::uint64_t>(shifted);
+    return shifted - magic;
+}
+inline double fastRound(double x) {
+    std::int32_t low{ };
+    return fastRound(x, low);
+}
+
+// sin(r) and cos(r) for |r| <= pi/4 (fdlibm kernel polynomials)
+inline double sinKernel(double r) {
+    double z{ r*r };
+    return r + r*z*(-1.66666666666666324348e-01 + z*(8.33333333332248946124e-03 + z*(-1.98412698298579493134e-04
+        + z*(2.75573137070700676789e-06 + z*(-2.50507602534068634195e-08 + z*1.58969099521155010221e-10)))));
+}
+inline double cosKernel(double r) {
+    double z{ r*r };
+    return 1 - 0.5*z + z*z*(4.16666666666666019037e-02 + z*(-1.38888888888741095749e-03 + z*(2.48015872894767294178e-05
+        + z*(-2.75573143513906633035e-07 + z*(2.08757232129817482790e-09 + z*-1.13596475577881948265e-11)))));
+}
+
+// Reduces x to r in [-pi/4, pi/4] with x = r + quadrant*pi/2
+inline double reduceQuarterPi(double x, std::int32_t& quadrant) {
+    double k{ fastRound(x * 0.63661977236758134308, quadrant) }; // 2/pi
+    // pi/2 split in three (fdlibm's pio2_1, pio2_2, pio2_2t) so the first two products and
+    // subtractions are exact, and r stays accurate next to multiples of pi/2 (where TAN divides by it)
+    return ((x - k*1.57079632673412561417e+00) - k*6.07710050630396597660e-11) - k*2.02226624879595063154e-21;
+}
+
+inline double fastSin(double x) {
+    std::int32_t quadrant{ };
+    double r{ reduceQuarterPi(x, quadrant) };
+    double s{ sinKernel(r) };
+    double c{ cosKernel(r) };
+    double value{ (quadrant & 1) ? c : s };
+    return (quadrant & 2) ? -value : value;
+}
+inline double fastCos(double x) {
+    std::int32_t quadrant{ };
+    double r{ reduceQuarterPi(x, quadrant) };
+    double s{ sinKernel(r) };
+    double c{ cosKernel(r) };
+    double value{ (quadrant & 1) ? s : c };
+    return ((quadrant + 1) & 2) ? -value : value;
+}
+inline double fastTan(double x) {
+    std::int32_t quadrant{ };
+    double r{ reduceQuarterPi(x, quadrant) };
+    double s{ sinKernel(r) };
+    double c{ cosKernel(r) };
+    return (quadrant & 1) ? -c/s : s/c;
+}
+
+inline double fastAtan(double x) {
+    double t{ std::abs(x) };
+    bool inverted{ t > 1 };
+    t = inverted ? 1/t : t;
+    // atan(t) = pi/4 + atan((t-1)/(t+1)), so u stays within tan(pi/8)
+    bool shifted{ t > 0.41421356237309504880 };
+    double u{ shifted ? (t - 1)/(t + 1) : t };
+    double z{ u*u };
+    double series{ u*(1 + z*(-1.0/3 + z*(1.0/5 + z*(-1.0/7 + z*(1.0/9 + z*(-1.0/11 + z*(1.0/13
+        + z*(-1.0/15 + z*(1.0/17 + z*(-1.0/19 + z*(1.0/21))))))))))) };
+    double value{ shifted ? 0.78539816339744830962 + series : series };
+    value = inverted ? 1.57079632679489661923 - value : value;
+    return x < 0 ? -value : value;
+}
+inline double fastAsin(double x) {
+    return fastAtan(x / std::sqrt(1 - x*x));
+}
+inline double fastAcos(double x) {
+    return 1.57079632679489661923 - fastAsin(x);
+}
+
+// log(x) split into e*log(2) + series, from the exponent bits (e) and a series for the mantissa.
+// Only for x > 0, the callers handle the rest
+inline double logParts(double x, double& e) {
+    // Scale up subnormals so their exponent bits are usable
+    bool tiny{ x < 2.2250738585072014e-308 };
+    double scaled{ tiny ? x * 18014398509481984.0 : x }; // 2^54
+    std::uint64_t bits{ std::bit_cast<std::uint64_t>(scaled) };
+    std::int64_t exponent{ (std::int64_t)((bits >> 52) & 0x7ff) - 1023 };
+    double m{ std::bit_cast<double>((bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL) };
+    // Keep m within sqrt(1/2)..sqrt(2) so the series converges quickly
+    bool high{ m > 1.41421356237309504880 };
+    m = high ? m * 0.5 : m;
+    e = (double)(exponent + (high ? 1 : 0) - (tiny ? 54 : 0));
+    // log(m) = 2 atanh(s), |s| < 0.172 so the terms left out are below 1e-19
+    double s{ (m - 1)/(m + 1) };
+    double z{ s*s };
+    return 2*s*(1 + z*(1.0/3 + z*(1.0/5 + z*(1.0/7 + z*(1.0/9 + z*(1.0/11 + z*(1.0/13 + z*(1.0/15
+        + z*(1.0/17 + z*(1.0/19 + z*(1.0/21)))))))))));
+}
+// Same special cases as std::log
+inline double logSpecial(double x, double value) {
+    value = x == 0 ? -INFINITY : value;
+    value = x == INFINITY ? INFINITY : value;
+    return (x < 0 || x != x) ? NAN : value;
+}
+
+// Natural log. e*log(2) is split in two (fdlibm's ln2_hi, ln2_lo) so e*ln2Hi is exact
+inline double fastLog(double x) {
+    double e{ };
+    double series{ logParts(x, e) };
+    return logSpecial(x, e*6.93147180369123816490e-01 + (e*1.90821492927058770002e-10 + series));
+}
+// Log base 2, e is exact here so only the series is scaled
+inline double fastLog2(double x) {
+    double e{ };
+    double series{ logParts(x, e) };
+    return logSpecial(x, e + series * 1.44269504088896340736); // 1/ln(2)
+}
+inline double fastLog10(double x) {
+    return fastLog(x) * 0.43429448190325182765; // 1/ln(10)
+}
+
+inline double fastExp2(double y) {
+    double clamped{ y > 1024 ? 1024 : (y < -1075 ? -1075 : y) };
+    clamped = y != y ? 0 : clamped;
+    std::int32_t k{ };
+    double r{ (clamped - fastRound(clamped, k)) * 0.69314718055994530942 }; // |r| <= ln(2)/2
+    double series{ 1 + r*(1 + r*(1.0/2 + r*(1.0/6 + r*(1.0/24 + r*(1.0/120 + r*(1.0/720
+        + r*(1.0/5040 + r*(1.0/40320 + r*(1.0/362880 + r*(1.0/3628800 + r*(1.0/39916800
+        + r*(1.0/479001600 + r*(1.0/6227020800))))))))))))) };
+    // Multiply by 2^k in two halves so results near the ends of the range don't overflow the exponent bits
+    std::int64_t half{ k / 2 };
+    double scaleA{ std::bit_cast<double>((std::uint64_t)(half + 1023) << 52) };
+    double scaleB{ std::bit_cast<double>((std::uint64_t)(k - half + 1023) << 52) };
+    double value{ series * scaleA * scaleB };
+    value = y >= 1024 ? INFINITY : value;
+    value = y < -1075 ? 0 : value;
+    return y != y ? NAN : value;
+}
+
+// Same special cases as std::pow for the values a graph can produce
+inline double fastPow(double base, double exponent) {
+    double magnitude{ fastExp2(exponent * fastLog2(std::abs(base))) };
+    std::int32_t low{ };
+    bool huge{ std::abs(exponent) >= 2251799813685248.0 }; // 2^51, always even
+    bool integer{ huge || fastRound(exponent, low) == exponent };
+    bool odd{ !huge && integer && (low & 1) };
+    double value{ (base < 0 && odd) ? -magnitude : magnitude };
+    value = (base < 0 && !integer) ? NAN : value;
+    return exponent == 0 ? 1 : value;
+}
+inline double fastCbrt(double x) {
+    double magnitude{ fastExp2(fastLog2(std::abs(x)) * (1.0/3)) };
+    return x < 0 ? -magnitude : magnitude;
+}
+
+// doFunction for p::fast
+inline double fastFunction(f name, double value) {
+    switch(name) {
+        case f::sin:  return fastSin(value);
+        case f::asin: return fastAsin(value);
+        case f::cos:  return fastCos(value);
+        case f::acos: return fastAcos(value);
+        case f::tan:  return fastTan(value);
+        case f::atan: return fastAtan(value);
+        case f::sqrt: return std::sqrt(value);
+        case f::cbrt: return fastCbrt(value);
+        case f::log:  return fastLog10(value);
+        case f::lb:   return fastLog2(value);
+        case f::ln:   return fastLog(value);
+        case f::abs:  return std::abs(value);
+        case f::sign: return value > 0 ? 1 : (value == 0 ? 0 : -1);
+        case f::even: return std::fmod(value, 2);
+        case f::pi:   return value != 0 ? 3.14159265358979323846 * value : 3.14159265358979323846;
+        case f::e:    return value != 0 ? 2.71828182845904523536 * value : 2.71828182845904523536;
+        case f::none:
+        default: return 0;
+    }
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include "grid.hpp"
+#include "tree.hpp"
+
+// Graphs of functions, y = f(x) (see m::function), and of parametric and polar curves.
+// Instead of solving every point of the window, f is solved more where it bends and less where
+// it's straight, and curves are solved along t until they're unbroken.
+// Their grids' points[x] hold the ranges of y the curve covers in column x,
+// as (low, high) pairs, so they can be drawn (see drawCurve) without solving anything else.
+
+// Turns a function into the equation graphed by createGrid: 0 = f(x) - y
+inline TreeItem functionToEquation(const TreeItem& function) {
+    return {
+        .operation = o::subtract,
+        .left = new TreeItem{ copyTree(function) },
+        .right = new TreeItem{ .isVariable = true, .variable = 'y' }
+    };
+}
+
+// Solves a function at every x, as one batch
+inline std::vector<double> solveFunction(const Program& program, const Grid& settings, const std::vector<double>& xs) {
+    Batch batch{ .size = xs.size(), .precision = settings.precision == p::fast ? p::fast : p::exact };
+    batch.varying['x'] = xs;
+    Lanes lanes{ };
+    solveBatch(program, batch, lanes);
+    std::vector<double> out(xs.size());
+    for (std::size_t lane{ 0 }; lane < xs.size(); lane++) out[lane] = laneValue(lanes, program.roots[0], lane);
+    return out;
+}
+
+// A value of a function, and whether the gap to the next one still needs splitting (or can't be joined)
+struct FunctionPoint {
+    double x{ };
+    double y{ };
+    int depth{ 0 };
+    bool split{ false };
+    bool jump{ false };
+};
+
+// Solves a function (compiled, see compileTree) across a grid's window, adaptively.
+// It starts from a value every 4 columns, then solves the middle of every gap whose middle was more than a
+// quarter of a cell off the straight line between its ends last time, or whose ends are more than a cell
+// apart. All the middles of a pass are solved as one batch. So flat stretches are only solved a few times,
+// and bends and steep parts as many times as it takes to draw them (only while they're on screen).
+// Gaps still more than a cell apart after settings.sampleDepth splits are jumps (eg at an asymptote
+// of TAN, or a step of SIGN) and aren't joined up. At most settings.sampleBudget values are solved, out.solved says how many.
+// Float precision solves functions in double precision. If cancel gets set, the grid is left unfinished.
+inline Grid createCurve(const Program& program, const Grid& settings, const std::atomic<bool>* cancel = nullptr) {
+    int xSteps{ gridColumns(settings) };
+    Grid out{ settings };
+    out.mode = m::function;
+    out.points = { };
+    out.points.resize(xSteps);
+
+    const int startColumns{ 4 };
+    const double tolerance{ settings.stepY / 4 };
+    std::vector<double> xs{ };
+    for (int x{ 0 }; x <= xSteps + startColumns-1; x += startColumns) {
+        xs.push_back((x - 0.5) * settings.stepX + settings.startX);
+    }
+    std::vector<double> ys{ solveFunction(program, settings, xs) };
+    out.solved = xs.size();
+    std::vector<FunctionPoint> curve{ };
+    for (std::size_t i{ 0 }; i < xs.size(); i++) curve.push_back({ xs[i], ys[i], 0, i+1 < xs.size() });
+
+    while (true) {
+        if (cancel != nullptr && *cancel) return out;
+        xs.clear();
+        for (std::size_t i{ 0 }; i+1 < curve.size(); i++) {
+            if (curve[i].split) xs.push_back((curve[i].x + curve[i+1].x) / 2);
+        }
+        if (xs.size() == 0 || out.solved + xs.size() > settings.sampleBudget) break;
+        ys = solveFunction(program, settings, xs);
+        out.solved += xs.size();
+
+        std::vector<FunctionPoint> merged{ };
+        merged.reserve(curve.size() + xs.size());
+        for (std::size_t i{ 0 }, next{ 0 }; i < curve.size(); i++) {
+            merged.push_back(curve[i]);
+            if (!curve[i].split) continue;
+            const double y0{ curve[i].y };
+            const double y1{ curve[i+1].y };
+            const double middle{ ys[next] };
+            bool bent{ std::isfinite(y0) && std::isfinite(middle) && std::isfinite(y1)
+                && std::abs(middle - (y0 + y1) / 2) > tolerance };
+            bool deeper{ curve[i].depth + 1 < settings.sampleDepth };
+            // Each half is split again if the whole gap bent, or its ends are more than a cell apart
+            // (a jump can have its middle right on the line), unless both ends are off the same side
+            // of the window. Or if it's where the function stops being finite
+            auto setGap{ [&](FunctionPoint& point, double a, double b) {
+                point.depth = curve[i].depth + 1;
+                if (!std::isfinite(a) || !std::isfinite(b)) {
+                    point.split = deeper && std::isfinite(a) != std::isfinite(b);
+                    return;
+                }
+                bool apart{ std::abs(b - a) > settings.stepY };
+                bool offScreen{ std::min(a, b) > settings.endY + settings.stepY || std::max(a, b) < settings.startY - settings.stepY };
+                point.split = deeper && !offScreen && (bent || apart);
+                point.jump = !deeper && apart;
+            } };
+            setGap(merged.back(), y0, middle);
+            merged.push_back({ xs[next++], middle });
+            setGap(merged.back(), middle, y1);
+        }
+        curve = std::move(merged);
+    }
+
+    // Join up neighbouring values, splitting each line between the columns it crosses
+    auto cover{ [&](int x, double y0, double y1) {
+        if (x < 0 || x >= xSteps) return;
+        out.points[x].push_back(std::min(y0, y1));
+        out.points[x].push_back(std::max(y0, y1));
+    } };
+    auto column{ [&](double x) { return (int)std::round((x - settings.startX) / settings.stepX); } };
+    for (std::size_t i{ 0 }; i < curve.size(); i++) {
+        const FunctionPoint& point{ curve[i] };
+        if (!std::isfinite(point.y)) continue;
+        cover(column(point.x), point.y, point.y);
+        if (i+1 == curve.size() || point.jump || !std::isfinite(curve[i+1].y)) continue;
+
+        const FunctionPoint& next{ curve[i+1] };
+        double y{ point.y };
+        for (int x{ column(point.x) }; x < column(next.x); x++) {
+            double edge{ (x + 0.5) * settings.stepX + settings.startX };
+            double yEdge{ point.y + (next.y - point.y) * (edge - point.x) / (next.x - point.x) };
+            cover(x, y, yEdge);
+            y = yEdge;
+        }
+        cover(column(next.x), y, next.y);
+    }
+    return out;
+}
+
+// Adds each column's runs of marked cells (marked[x][y]) to a curve grid's ranges
+inline void addMarkedRanges(Grid& out, const std::vector<std::vector<char>>& marked) {
+    for (std::size_t x{ 0 }; x < marked.size(); x++) {
+        const int ySteps{ (int)marked[x].size() };
+        for (int y{ 0 }; y < ySteps; y++) {
+            if (!marked[x][y]) continue;
+            int top{ y };
+            while (top+1 < ySteps && marked[x][top+1]) top++;
+            out.points[x].push_back(y*out.stepY + out.startY);
+            out.points[x].push_back(top*out.stepY + out.startY);
+            y = top;
+        }
+    }
+}
+
+// A point on a parametric or polar curve
+struct CurvePoint {
+    double t{ };
+    double x{ };
+    double y{ };
+};
+
+// Solves a parametric (roots x(t), y(t)) or polar (root r(t)) curve at every t, as one batch
+inline std::vector<CurvePoint> solveCurvePoints(const Program& program, const Grid& settings, const std::vector<double>& ts) {
+    Batch batch{ .size = ts.size(), .precision = settings.precision == p::fast ? p::fast : p::exact };
+    batch.varying['t'] = ts;
+    Lanes lanes{ };
+    solveBatch(program, batch, lanes);
+
+    std::vector<CurvePoint> out(ts.size());
+    for (std::size_t lane{ 0 }; lane < ts.size(); lane++) {
+        double first{ laneValue(lanes, program.roots[0], lane) };
+        if (settings.mode == m::polar) {
+            out[lane] = { ts[lane], first * std::cos(ts[lane]), first * std::sin(ts[lane]) };
+        } else {
+            out[lane] = { ts[lane], first, laneValue(lanes, program.roots[1], lane) };
+        }
+    }
+    return out;
+}
+
+// Solves a parametric or polar curve (see m::parametric) for t from settings.startT to endT.
+// t starts out evenly spaced, then a t is added between every two neighbouring points that are more than
+// a cell apart and could be in the window, as one batch per pass, until the curve is unbroken.
+// So the points solved grow with how long the curve is on screen, not with the size of the window.
+// Points that stay apart after halving t many times are a jump, and are left apart.
+// If cancel gets set, the grid is left unfinished.
+inline Grid createParametric(const Program& program, const Grid& settings, const std::atomic<bool>* cancel = nullptr) {
+    int xSteps{ gridColumns(settings) };
+    int ySteps{ gridRows(settings) };
+    Grid out{ settings };
+    out.points = { };
+    out.points.resize(xSteps);
+
+    const int startPoints{ 256 };
+    const double smallestStep{ (settings.endT - settings.startT) / startPoints / (1 << 20) };
+    const std::size_t mostPoints{ 1 << 22 };
+
+    std::vector<double> ts{ };
+    for (int i{ 0 }; i <= startPoints; i++) {
+        ts.push_back(settings.startT + (settings.endT - settings.startT) * i / startPoints);
+    }
+    std::vector<CurvePoint> curve{ solveCurvePoints(program, settings, ts) };
+    out.solved = curve.size();
+
+    auto apart{ [&](const CurvePoint& a, const CurvePoint& b) {
+        if (!std::isfinite(a.x) || !std::isfinite(a.y) || !std::isfinite(b.x) || !std::isfinite(b.y)) return false;
+        if (std::abs(b.x - a.x) <= settings.stepX && std::abs(b.y - a.y) <= settings.stepY) return false;
+        if (b.t - a.t < smallestStep) return false;
+        // Both off the same side of the window
+        return !(std::max(a.x, b.x) < settings.startX - settings.stepX || std::min(a.x, b.x) > settings.endX + settings.stepX
+            || std::max(a.y, b.y) < settings.startY - settings.stepY || std::min(a.y, b.y) > settings.endY + settings.stepY);
+    } };
+    while (curve.size() < mostPoints) {
+        if (cancel != nullptr && *cancel) return out;
+        ts.clear();
+        for (std::size_t i{ 0 }; i+1 < curve.size(); i++) {
+            if (apart(curve[i], curve[i+1])) ts.push_back((curve[i].t + curve[i+1].t) / 2);
+        }
+        if (ts.size() == 0) break;
+
+        std::vector<CurvePoint> added{ solveCurvePoints(program, settings, ts) };
+        out.solved += added.size();
+        std::vector<CurvePoint> merged{ };
+        merged.reserve(curve.size() + added.size());
+        std::size_t next{ 0 };
+        for (std::size_t i{ 0 }; i < curve.size(); i++) {
+            merged.push_back(curve[i]);
+            if (next < added.size() && i+1 < curve.size() && added[next].t < curve[i+1].t && added[next].t > curve[i].t) {
+                merged.push_back(added[next++]);
+            }
+        }
+        curve = std::move(merged);
+    }
+
+    // Mark the cells the points are in
+    std::vector<std::vector<char>> marked(xSteps, std::vector<char>(ySteps, false));
+    for (const CurvePoint& point : curve) {
+        double x{ std::round((point.x - settings.startX) / settings.stepX) };
+        double y{ std::round((point.y - settings.startY) / settings.stepY) };
+        if (x >= 0 && x < xSteps && y >= 0 && y < ySteps) marked[(int)x][(int)y] = true;
+    }
+    addMarkedRanges(out, marked);
+    return out;
+}
+
+// Draws a function or curve grid (see createCurve, createParametric), with '#' wherever the curve passes through a cell
+inline void drawCurve(const Grid& grid, std::ostream& out = std::cout) {
+    drawFrame(grid, [&](int x, int y) {
+        double bottom{ (y - 0.5)*grid.stepY + grid.startY };
+        double top{ (y + 0.5)*grid.stepY + grid.startY };
+        const std::vector<double>& ranges{ grid.points.at(x) };
+        for (std::size_t i{ 0 }; i+1 < ranges.size(); i += 2) {
+            if (ranges[i] <= top && ranges[i+1] >= bottom) return '#';
+        }
+        return ' ';
+    }, out);
+}
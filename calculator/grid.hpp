@@ -1,85 +1,574 @@
 #pragma once
-#include "solve.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
 #include <iomanip>
+#include <stdexcept>
+#include <utility>
+#include "compile.hpp"
+#include "symmetry.hpp"
 
-Grid createGrid(const TreeItem& equation, const Grid& settings) {
-    Grid out{ settings };
+// Number of points createGrid solves across and up a grid (ranges are inclusive)
+inline int gridColumns(const Grid& grid) {
+    return (int)std::floor((grid.endX - grid.startX)/grid.stepX + 1);
+}
+inline int gridRows(const Grid& grid) {
+    return (int)std::floor((grid.endY - grid.startY)/grid.stepY + 1);
+}
 
-    if (out.startX >= out.endX || out.startY >= out.endY) {
-        throw std::invalid_argument("Grid start positions must be less than end positions");
+// Which points of a grid mirror others (see symmetry.hpp). columns has a sign per result: 1 if it's even
+// in x, -1 if it's odd, and is empty unless every result is one or the other and the window's columns
+// mirror each other about x = 0 (eg after :center). rows is the same for y. Column x mirrors column
+// xSteps-1-x, so only the first half needs solving
+struct GridSymmetry {
+    std::vector<double> columns{ };
+    std::vector<double> rows{ };
+};
+inline GridSymmetry gridSymmetry(const Program& program, const Grid& settings) {
+    auto signs{ [&](char variable, double start, double step, int count) {
+        std::vector<double> out{ };
+        // The last point must be -start. Only to a billionth of a step: with steps like 0.1 the points
+        // don't add up exactly, and the mirrored half is as if it was solved at exactly -x (or -y)
+        if (count < 2 || std::abs(2*start + (count-1)*step) > step * 1e-9) return out;
+        std::vector<Parity> parity{ programParity(program, variable) };
+        for (const int root : program.roots) {
+            if (parity[root] == Parity::neither) return std::vector<double>{ };
+            out.push_back(parity[root] == Parity::odd ? -1 : 1);
+        }
+        return out;
+    } };
+    return {
+        signs('x', settings.startX, settings.stepX, gridColumns(settings)),
+        signs('y', settings.startY, settings.stepY, gridRows(settings))
+    };
+}
+
+// Empty sign planes for a grid of columns x rows (see SignPlanes)
+inline SignPlanes makeSigns(int columns, int rows) {
+    SignPlanes signs{ .columns = columns, .rows = rows, .words = (rows + 63) / 64 };
+    signs.nonNegative.assign((std::size_t)columns * signs.words, 0);
+    signs.nonPositive.assign((std::size_t)columns * signs.words, 0);
+    return signs;
+}
+inline bool signBit(const SignPlanes& signs, const std::vector<std::uint64_t>& plane, int x, int y) {
+    return (plane[(std::size_t)x*signs.words + y/64] >> (y%64)) & 1;
+}
+
+// Sets one point's signs, from its value or from another point's (negated if negate). For points
+// solved a few at a time (see solveGridStride), whole columns are packed with packColumn
+inline void setSignBits(SignPlanes& signs, int x, int y, bool nonNegative, bool nonPositive) {
+    const std::size_t word{ (std::size_t)x*signs.words + y/64 };
+    const std::uint64_t bit{ std::uint64_t{ 1 } << (y%64) };
+    signs.nonNegative[word] = nonNegative ? signs.nonNegative[word] | bit : signs.nonNegative[word] & ~bit;
+    signs.nonPositive[word] = nonPositive ? signs.nonPositive[word] | bit : signs.nonPositive[word] & ~bit;
+}
+inline void setSign(SignPlanes& signs, int x, int y, double value) {
+    setSignBits(signs, x, y, value >= 0, value <= 0);
+}
+inline void copySign(SignPlanes& to, int x, int y, const SignPlanes& from, int fromX, int fromY, bool negate) {
+    bool nonNegative{ signBit(from, from.nonNegative, fromX, fromY) };
+    bool nonPositive{ signBit(from, from.nonPositive, fromX, fromY) };
+    if (negate) std::swap(nonNegative, nonPositive);
+    setSignBits(to, x, y, nonNegative, nonPositive);
+}
+
+// Packs a solved column's signs, a word at a time
+inline void packColumn(SignPlanes& signs, int x, const std::vector<double>& column) {
+    for (int k{ 0 }; k < signs.words; k++) {
+        const int end{ std::min(64, signs.rows - k*64) };
+        const double* values{ &column[k*64] };
+        std::uint64_t nonNegative{ 0 };
+        std::uint64_t nonPositive{ 0 };
+        for (int bit{ 0 }; bit < end; bit++) {
+            nonNegative |= (std::uint64_t)(values[bit] >= 0) << bit;
+            nonPositive |= (std::uint64_t)(values[bit] <= 0) << bit;
+        }
+        signs.nonNegative[(std::size_t)x*signs.words + k] = nonNegative;
+        signs.nonPositive[(std::size_t)x*signs.words + k] = nonPositive;
     }
+}
 
-    int xSteps{ (int)std::floor((out.endX - out.startX)/out.stepX + 1) }; // +1 b/c grid ranges are inclusive
-    int ySteps{ (int)std::floor((out.endY - out.startY)/out.stepY + 1) };
+// Solves a program for every column of a grid, as one batch over y per column.
+// Parts of the program that only read y are solved once for the whole grid, and parts
+// that only read x are solved once per column (see resolveBatch).
+// column(x, lanes, batch) is called after each column is solved.
+// Stops early (leaving the rest of the columns unsolved) if cancel is set.
+template <typename T, typename Column>
+void solveGridColumns(const Program& program, const Grid& settings, Column column, const std::atomic<bool>* cancel = nullptr) {
+    int xSteps{ gridColumns(settings) };
+    int ySteps{ gridRows(settings) };
 
-    // clear any points that might've been copied from the settings
-    out.points = { };
-    out.points.resize(xSteps);
+    Batch batch{ .size = (std::size_t)ySteps, .precision = settings.precision };
+    std::vector<double>& ys{ batch.varying['y'] };
+    for (int y{ 0 }; y < ySteps; y++) {
+        ys.push_back((y*settings.stepY) + settings.startY);
+    }
+    LanesOf<T> lanes{ };
 
     for (int x{ 0 }; x < xSteps; x++) {
-        std::vector<double>& xVector{ out.points.at(x) };
-        xVector.resize(ySteps);
+        if (cancel != nullptr && *cancel) return;
+        batch.variables['x'-'a'] = (x*settings.stepX) + settings.startX;
+        if (x == 0) solveBatch(program, batch, lanes);
+        else resolveBatch(program, batch, lanes, varBit('x'));
+        column(x, lanes, batch);
+    }
+}
+
+// Solves every result of a program (see compileTrees) over the same grid in one pass.
+// Subexpressions shared between the results are only solved once per point, and only half (or a
+// quarter) of the grid is solved if the rest mirrors it (see gridSymmetry).
+// Returns one grid per program.roots, in the same order. If cancel gets set, the grids are left unfinished.
+// Grids that are only going to be drawn can be solved signsOnly: their points are left empty, and each
+// column is packed into Grid::signs as soon as it's solved (2 bits a point instead of a double)
+inline std::vector<Grid> createOverlay(const Program& program, const Grid& settings, const std::atomic<bool>* cancel = nullptr, bool signsOnly = false) {
+    if (settings.startX >= settings.endX || settings.startY >= settings.endY) {
+        throw std::invalid_argument("Grid start positions must be less than end positions");
+    }
+
+    int xSteps{ gridColumns(settings) };
+    int ySteps{ gridRows(settings) };
+
+    std::vector<Grid> out(program.roots.size(), settings);
+    for (Grid& grid : out) {
+        // clear any points that might've been copied from the settings
+        grid.mode = m::equation;
+        grid.engine = e::grid;
+        grid.points = { };
+        grid.signs = { };
+        if (signsOnly) grid.signs = makeSigns(xSteps, ySteps);
+        else grid.points.resize(xSteps, std::vector<double>(ySteps));
+    }
+
+    const GridSymmetry symmetry{ gridSymmetry(program, settings) };
+    Grid solving{ settings };
+    if (symmetry.columns.size() > 0) solving.endX = settings.startX + ((xSteps-1)/2 + 0.5) * settings.stepX;
+    if (symmetry.rows.size() > 0) solving.endY = settings.startY + ((ySteps-1)/2 + 0.5) * settings.stepY;
+    const int solvedRows{ gridRows(solving) };
+
+    // Each result's column is solved into columns, then finishColumn fills in the rows that mirror
+    // the solved ones and stores it, along with the column that mirrors it (see gridSymmetry)
+    std::vector<std::vector<double>> columns(out.size(), std::vector<double>(ySteps));
+    std::vector<double> mirrored(ySteps);
+    auto store{ [&](std::size_t i, int x, const std::vector<double>& column) {
+        if (signsOnly) packColumn(out[i].signs, x, column);
+        else out[i].points[x] = column;
+    } };
+    auto finishColumn{ [&](int x) {
+        for (std::size_t i{ 0 }; i < out.size(); i++) {
+            std::vector<double>& column{ columns[i] };
+            if (symmetry.rows.size() > 0) {
+                for (int y{ solvedRows }; y < ySteps; y++) column[y] = symmetry.rows[i] * column[ySteps-1-y];
+            }
+            store(i, x, column);
+            if (symmetry.columns.size() > 0 && xSteps-1-x != x) {
+                for (int y{ 0 }; y < ySteps; y++) mirrored[y] = symmetry.columns[i] * column[y];
+                store(i, xSteps-1-x, mirrored);
+            }
+        }
+    } };
+    auto copyColumn{ [&](const auto& lanes) {
+        for (std::size_t i{ 0 }; i < out.size(); i++) {
+            const auto& values{ lanes[program.roots[i]] };
+            std::vector<double>& column{ columns[i] };
+            if (values.size() == 1) std::fill(column.begin(), column.end(), values[0]);
+            else std::copy(values.begin(), values.end(), column.begin());
+        }
+    } };
+
+    if (settings.precision != p::single) {
+        solveGridColumns<double>(program, solving, [&](int x, const Lanes& lanes, const Batch&) {
+            copyColumn(lanes);
+            finishColumn(x);
+        }, cancel);
+        return out;
+    }
+
+    // Floats are accurate to about 1 part in 2^24 of the values they were solved from, so
+    // points within 2^-16 of the largest (finite) value in their column could have the wrong
+    // sign. Those are solved again in double precision. Only the values that can't be scanned
+    // once per grid or per column are the results and the operands of the results,
+    // which is where the terms of an equation cancel out.
+    const double threshold{ 1.0 / 65536 };
+    std::vector<bool> scanned(program.code.size(), false);
+    for (const int root : program.roots) {
+        const Instruction& ins{ program.code[root] };
+        for (const int i : { root, ins.left, ins.right }) {
+            if (i != -1) scanned[i] = true;
+        }
+    }
+    std::uint32_t unchanging{ 0 };
+    // Points where any value overflowed (or was inf/NaN anyway, eg at an asymptote) can't be trusted
+    // either, since double precision might not have overflowed there. The exponent bits of inf and
+    // NaN are all set. Lanes that don't read x are only checked once
+    std::vector<char> unchangingOverflow(solvedRows, false);
+    auto overflowIn{ [&](const LanesOf<float>& lanes, bool readingX, std::vector<char>& out) {
+        for (std::size_t i{ 0 }; i < lanes.size(); i++) {
+            if (((program.code[i].reads & varBit('x')) != 0) != readingX) continue;
+            const std::vector<float>& values{ lanes[i] };
+            if (values.size() == 1) {
+                if (!std::isfinite(values[0])) std::fill(out.begin(), out.end(), true);
+                continue;
+            }
+            for (int y{ 0 }; y < solvedRows; y++) {
+                out[y] |= (std::bit_cast<std::uint32_t>(values[y]) & 0x7f800000) == 0x7f800000;
+            }
+        }
+    } };
+    solveGridColumns<float>(program, solving, [&](int x, const LanesOf<float>& lanes, const Batch& batch) {
+        copyColumn(lanes);
+
+        // Lanes that don't read x stay the same, so only scan them once.
+        // The magnitudes are compared as bits (same order as the floats), which skips inf/NaN
+        // and lets the loop be vectorized
+        auto largestIn{ [&](bool readingX) {
+            std::uint32_t largest{ 0 };
+            for (std::size_t i{ 0 }; i < lanes.size(); i++) {
+                if (((program.code[i].reads & varBit('x')) != 0) != readingX) continue;
+                if (readingX && lanes[i].size() > 1 && !scanned[i]) continue;
+                for (const float value : lanes[i]) {
+                    std::uint32_t magnitude{ std::bit_cast<std::uint32_t>(value) & 0x7fffffff };
+                    magnitude = magnitude < 0x7f800000 ? magnitude : 0;
+                    largest = magnitude > largest ? magnitude : largest;
+                }
+            }
+            return largest;
+        } };
+        if (x == 0) {
+            unchanging = largestIn(false);
+            overflowIn(lanes, false, unchangingOverflow);
+        }
+        float largest{ std::bit_cast<float>(std::max(unchanging, largestIn(true))) };
+        const double limit{ largest * threshold };
+
+        std::vector<char> near{ unchangingOverflow };
+        overflowIn(lanes, true, near);
+        for (const std::vector<double>& column : columns) {
+            for (int y{ 0 }; y < solvedRows; y++) {
+                near[y] |= std::abs(column[y]) <= limit;
+            }
+        }
+
+        Batch exact{ .variables = batch.variables };
+        std::vector<int> redo{ };
+        std::vector<double>& ys{ exact.varying['y'] };
+        const std::vector<double>& allYs{ batch.varying.at('y') };
+        for (int y{ 0 }; y < solvedRows; y++) {
+            if (!near[y]) continue;
+            redo.push_back(y);
+            ys.push_back(allYs[y]);
+        }
+        if (redo.size() > 0) {
+            exact.size = redo.size();
+            Lanes exactLanes{ };
+            solveBatch(program, exact, exactLanes);
+            for (std::size_t i{ 0 }; i < out.size(); i++) {
+                for (std::size_t lane{ 0 }; lane < redo.size(); lane++) {
+                    columns[i][redo[lane]] = laneValue(exactLanes, program.roots[i], lane);
+                }
+                out[i].refined += redo.size();
+            }
+        }
+        finishColumn(x);
+    }, cancel);
+    return out;
+}
+
+// Solves several equations over the same grid in one pass. Returns one grid per equation, in the same order.
+inline std::vector<Grid> createOverlay(const std::vector<TreeItem>& equations, const Grid& settings, bool signsOnly = false) {
+    return createOverlay(compileTrees(equations), settings, nullptr, signsOnly);
+}
+
+inline Grid createGrid(const TreeItem& equation, const Grid& settings) {
+    std::vector<Grid> grids{ createOverlay({ equation }, settings) };
+    return std::move(grids.at(0));
+}
+
+// Solves the points of a grid whose column and row are both multiples of stride.
+// grid.points (or grid.signs, for grids that are only drawn) must already be the full size (see
+// gridColumns/gridRows and makeSigns). If coarser is true, points on multiples of stride*2 were solved
+// by an earlier call and are skipped, so a grid can be solved coarse-to-fine (eg stride 8, then 4, 2
+// and 1 with coarser) without solving any point twice.
+// p::single grids are solved in double precision here. Points that mirror ones already solved at this
+// stride (see gridSymmetry) are copied instead.
+inline void solveGridStride(const Program& program, Grid& grid, int stride, bool coarser, const std::atomic<bool>* cancel = nullptr) {
+    const bool signsOnly{ grid.signs.columns > 0 };
+    int xSteps{ signsOnly ? grid.signs.columns : (int)grid.points.size() };
+    int ySteps{ signsOnly ? grid.signs.rows : xSteps > 0 ? (int)grid.points[0].size() : 0 };
+    const GridSymmetry symmetry{ gridSymmetry(program, grid) };
+    auto mirrored{ [&](int i, int steps, const std::vector<double>& signs) {
+        return signs.size() > 0 && steps-1-i < i && (steps-1-i) % stride == 0;
+    } };
+    auto put{ [&](int x, int y, double value) {
+        if (signsOnly) setSign(grid.signs, x, y, value);
+        else grid.points[x][y] = value;
+    } };
+    auto copy{ [&](int x, int y, int fromX, int fromY, double sign) {
+        if (signsOnly) copySign(grid.signs, x, y, grid.signs, fromX, fromY, sign < 0);
+        else grid.points[x][y] = sign * grid.points[fromX][fromY];
+    } };
 
-        for (int y{ 0 }; y < ySteps; y++) {
-            // Solve for each point
-            xVector.at(y) = solveTree(equation, {
-                {'x', (x*out.stepX) + out.startX},
-                {'y', (y*out.stepY) + out.startY}
-            });
+    // Columns already solved at stride*2 only need the rows between the ones they have
+    Batch every{ .size = 0, .precision = grid.precision };
+    Batch between{ .size = 0, .precision = grid.precision };
+    std::vector<int> everyRows{ };
+    std::vector<int> betweenRows{ };
+    std::vector<int> mirroredRows{ };
+    for (int y{ 0 }; y < ySteps; y += stride) {
+        if (mirrored(y, ySteps, symmetry.rows)) {
+            mirroredRows.push_back(y);
+            continue;
         }
+        double yValue{ (y*grid.stepY) + grid.startY };
+        every.varying['y'].push_back(yValue);
+        everyRows.push_back(y);
+        if (y % (stride*2) != 0) {
+            between.varying['y'].push_back(yValue);
+            betweenRows.push_back(y);
+        }
+    }
+    every.size = everyRows.size();
+    between.size = betweenRows.size();
+
+    Lanes everyLanes{ };
+    Lanes betweenLanes{ };
+    bool everyStarted{ false };
+    bool betweenStarted{ false };
+    for (int x{ 0 }; x < xSteps; x += stride) {
+        if (cancel != nullptr && *cancel) return;
+        if (mirrored(x, xSteps, symmetry.columns)) {
+            for (int y{ 0 }; y < ySteps; y += stride) copy(x, y, xSteps-1-x, y, symmetry.columns[0]);
+            continue;
+        }
+        bool solvedBefore{ coarser && x % (stride*2) == 0 };
+        Batch& batch{ solvedBefore ? between : every };
+        Lanes& lanes{ solvedBefore ? betweenLanes : everyLanes };
+        bool& started{ solvedBefore ? betweenStarted : everyStarted };
+        const std::vector<int>& rows{ solvedBefore ? betweenRows : everyRows };
+        if (batch.size > 0) {
+            batch.variables['x'-'a'] = (x*grid.stepX) + grid.startX;
+            if (!started) solveBatch(program, batch, lanes);
+            else resolveBatch(program, batch, lanes, varBit('x'));
+            started = true;
+            for (std::size_t lane{ 0 }; lane < rows.size(); lane++) {
+                put(x, rows[lane], laneValue(lanes, program.roots[0], lane));
+            }
+        }
+        for (const int y : mirroredRows) copy(x, y, x, ySteps-1-y, symmetry.rows[0]);
     }
+}
 
+// A copy of a grid solved up to some stride (see solveGridStride), where every point is
+// the solved point at or before it in both directions, so it can be drawn at full size
+inline Grid fillGrid(const Grid& grid, int stride) {
+    Grid out{ grid };
+    for (int x{ 0 }; x < out.signs.columns; x++) {
+        for (int y{ 0 }; y < out.signs.rows; y++) {
+            copySign(out.signs, x, y, grid.signs, x - x % stride, y - y % stride, false);
+        }
+    }
+    for (std::size_t x{ 0 }; x < out.points.size(); x++) {
+        const std::vector<double>& solved{ grid.points[x - x % stride] };
+        std::vector<double>& column{ out.points[x] };
+        for (std::size_t y{ 0 }; y < column.size(); y++) {
+            column[y] = solved[y - y % stride];
+        }
+    }
     return out;
 }
 
-void printGrid(const Grid& grid) {
+inline void printGrid(const Grid& grid, std::ostream& out = std::cout) {
     for (const std::vector<double>& xV : grid.points) {
         for (const double val : xV) {
-            std::cout << val << ",\t";
+            out << val << ",\t";
         }
-        std::cout << ";\n";
+        out << ";\n";
     }
 }
 
-// Draws a grid.
-// IMPORTANT: The grid's settings must actually reflect the dimensions of the vectors!
-void drawGrid(const Grid& grid, bool thick = false) {
+// Prints a frame the size of the grid's window, with the axes and numbering.
+// row(y, line) fills in a row a line at a time: line[x-1] is the character for column x, left ' '
+// to draw the axes/background.
+template <typename Row>
+void drawFrameRows(const Grid& grid, Row row, std::ostream& out = std::cout) {
     double xSteps{ (grid.endX - grid.startX)/grid.stepX + 1 };
     double ySteps{ (grid.endY - grid.startY)/grid.stepY + 1 };
-    std::cout << "=====\n";
+    // The y axis, or ' ' in every other column
+    std::string axis{ };
+    for (int x{ 1 }; x < xSteps-2; x++) {
+        double actualX{ x*grid.stepX + grid.startX };
+        axis.push_back(std::abs(actualX) < grid.stepX/2 ? '|' : ' ');
+    }
+    out << "=====\n";
+    std::string line{ };
     // y goes backwards so it's printed right-side-up
     for (int y{ (int)ySteps-2 }; y > 0; y--) {
-        for (int x{ 1 }; x < xSteps-2; x++) {
-            double actualX{ x*grid.stepX + grid.startX };
-            double actualY{ y*grid.stepY + grid.startY };
-
-            bool sign{ grid.points.at(x).at(y) >= 0 };
-            bool sTop{ (grid.points.at(x).at(y+1) >= 0) != sign };
-            bool sBottom{ (grid.points.at(x).at(y-1) >= 0) != sign };
-            bool sRight{ (grid.points.at(x+1).at(y) >= 0) != sign };
-            bool sLeft{ (grid.points.at(x-1).at(y) >= 0) != sign };
-
-            // easy points
-            if (grid.points.at(x).at(y) == 0) std::cout << "0";
-            // positive side
-            else if (sign && (sTop || sBottom || sRight || sLeft)) std::cout << "#";
-            // negative side only if "thick"
-            else if (!sign && (sTop || sBottom || sRight || sLeft) && thick) std::cout << "*";
-            else if (std::abs(actualX) < grid.stepX/2) std::cout << '|';
-            else if (std::abs(actualY) < grid.stepY/2) std::cout << '_';
-            else std::cout << ' ';
-        }
-        
-        std::cout << " :" << std::setprecision(8) << y*grid.stepY + grid.startY
+        double actualY{ y*grid.stepY + grid.startY };
+        const char background{ std::abs(actualY) < grid.stepY/2 ? '_' : ' ' };
+        line.assign(axis.size(), ' ');
+        row(y, line);
+        for (std::size_t i{ 0 }; i < line.size(); i++) {
+            if (line[i] == ' ') line[i] = axis[i] != ' ' ? axis[i] : background;
+        }
+
+        out << line << " :" << std::setprecision(8) << y*grid.stepY + grid.startY
                   << '\n';
     }
-    std::cout << "          "; // account for y-axis numbering
+    out << "          "; // account for y-axis numbering
     for (int x{ 1 }; x < xSteps-2; x++) {
-        //std::cout << x-4 << ": ";
+        //out << x-4 << ": ";
         if (x % 10 == 0) {
             double actualX{ x*grid.stepX + grid.startX };
-            std::cout << std::setw(10) << actualX;
+            out << std::setw(10) << actualX;
+        }
+    }
+    out << "\n=====\n";
+}
+
+// Same as drawFrameRows, with cell(x, y) giving the character for each point
+template <typename Cell>
+void drawFrame(const Grid& grid, Cell cell, std::ostream& out = std::cout) {
+    drawFrameRows(grid, [&](int y, std::string& line) {
+        for (std::size_t i{ 0 }; i < line.size(); i++) line[i] = cell((int)i + 1, y);
+    }, out);
+}
+
+// What drawGrid shows at a point: '0' exactly on the curve, '#' next to a sign change,
+// '*' on the negative side of a sign change (only if thick), or ' ' if the curve isn't there.
+// drawGrid finds these for a whole grid at once, see findCurve
+inline char curveAt(const Grid& grid, int x, int y, bool thick) {
+    bool sign{ grid.points.at(x).at(y) >= 0 };
+    bool sTop{ (grid.points.at(x).at(y+1) >= 0) != sign };
+    bool sBottom{ (grid.points.at(x).at(y-1) >= 0) != sign };
+    bool sRight{ (grid.points.at(x+1).at(y) >= 0) != sign };
+    bool sLeft{ (grid.points.at(x-1).at(y) >= 0) != sign };
+
+    // easy points
+    if (grid.points.at(x).at(y) == 0) return '0';
+    // positive side
+    else if (sign && (sTop || sBottom || sRight || sLeft)) return '#';
+    // negative side only if "thick"
+    else if (!sign && (sTop || sBottom || sRight || sLeft) && thick) return '*';
+    return ' ';
+}
+
+// How many points are drawn differently in another precision than in exact precision (see checkPrecision)
+struct PrecisionCheck {
+    p precision{ p::fast };
+    double band{ 1e-9 };  // differences next to a point within this of 0 are expected (rounding can flip its sign)
+    int inBand{ 0 };
+    int outsideBand{ 0 }; // anything here is a bug
+};
+
+// Compares what drawGrid would show for an equation at the settings' precision (or fast, if it's
+// exact) against exact precision
+inline PrecisionCheck checkPrecision(const TreeItem& equation, const Grid& settings) {
+    PrecisionCheck out{ .precision = settings.precision == p::exact ? p::fast : settings.precision };
+    if (out.precision == p::single) out.band = 1e-3;
+    Grid exact{ settings };
+    Grid other{ settings };
+    exact.precision = p::exact;
+    other.precision = out.precision;
+    exact = createGrid(equation, exact);
+    other = createGrid(equation, other);
+
+    for (int x{ 1 }; x < gridColumns(settings)-2; x++) {
+        for (int y{ 1 }; y < gridRows(settings)-1; y++) {
+            if (curveAt(exact, x, y, true) == curveAt(other, x, y, true)) continue;
+
+            bool nearZero{ false };
+            for (const auto& [dx, dy] : { std::pair{ 0, 0 }, { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 } }) {
+                nearZero = nearZero || std::abs(exact.points.at(x+dx).at(y+dy)) < out.band;
+            }
+            if (nearZero) out.inBand++;
+            else out.outsideBand++;
+        }
+    }
+    return out;
+}
+
+// Packs a grid's points into sign planes
+inline SignPlanes packSigns(const Grid& grid) {
+    SignPlanes signs{ makeSigns((int)grid.points.size(), grid.points.size() > 0 ? (int)grid.points[0].size() : 0) };
+    for (int x{ 0 }; x < signs.columns; x++) packColumn(signs, x, grid.points[x]);
+    return signs;
+}
+// A grid's sign planes: Grid::signs if it was solved signsOnly (see createOverlay), or else its
+// points packed into packed
+inline const SignPlanes& gridSigns(const Grid& grid, SignPlanes& packed) {
+    if (grid.signs.columns > 0) return grid.signs;
+    packed = packSigns(grid);
+    return packed;
+}
+
+// The points curveAt would draw, as a plane laid out like SignPlanes'. A point is on the curve if its
+// sign differs from any of its four neighbours': the ones above and below are the column's words
+// shifted by a bit (carrying over from the next word), and the ones beside are the neighbouring
+// columns' words, so a whole word is found at a time. Points on the edge of the grid are never on
+// the curve, since drawFrameRows doesn't draw them
+inline std::vector<std::uint64_t> findCurve(const SignPlanes& signs, bool thick) {
+    const int words{ signs.words };
+    std::vector<std::uint64_t> curve((std::size_t)signs.columns * words, 0);
+    for (int x{ 1 }; x+1 < signs.columns; x++) {
+        const std::uint64_t* left{ &signs.nonNegative[(std::size_t)(x-1)*words] };
+        const std::uint64_t* here{ &signs.nonNegative[(std::size_t)x*words] };
+        const std::uint64_t* right{ &signs.nonNegative[(std::size_t)(x+1)*words] };
+        for (int k{ 0 }; k < words; k++) {
+            std::uint64_t sign{ here[k] };
+            std::uint64_t above{ (sign >> 1) | (k+1 < words ? here[k+1] << 63 : 0) };
+            std::uint64_t below{ (sign << 1) | (k > 0 ? here[k-1] >> 63 : 0) };
+            std::uint64_t changed{ (sign ^ above) | (sign ^ below) | (sign ^ left[k]) | (sign ^ right[k]) };
+            // Only the positive side, unless thick
+            std::size_t word{ (std::size_t)x*words + k };
+            std::uint64_t zero{ signs.nonNegative[word] & signs.nonPositive[word] };
+            curve[word] = zero | (changed & (thick ? ~std::uint64_t{ 0 } : sign));
         }
     }
-    std::cout << "\n=====\n";
+    return curve;
+}
+// The character curveAt gives for a point, from its grid's sign planes and curve (see findCurve)
+inline char signAt(const SignPlanes& signs, const std::vector<std::uint64_t>& curve, int x, int y) {
+    if (x < 0 || x >= signs.columns || y < 0 || y >= signs.rows || !signBit(signs, curve, x, y)) return ' ';
+    if (!signBit(signs, signs.nonNegative, x, y)) return '*';
+    return signBit(signs, signs.nonPositive, x, y) ? '0' : '#';
+}
+
+// Draws a grid.
+// IMPORTANT: The grid's settings must actually reflect the dimensions of the vectors!
+inline void drawGrid(const Grid& grid, bool thick = false, std::ostream& out = std::cout) {
+    SignPlanes packed{ };
+    const SignPlanes& signs{ gridSigns(grid, packed) };
+    const std::vector<std::uint64_t> curve{ findCurve(signs, thick) };
+    drawFrameRows(grid, [&](int y, std::string& line) {
+        for (std::size_t i{ 0 }; i < line.size(); i++) line[i] = signAt(signs, curve, (int)i + 1, y);
+    }, out);
+}
+
+// Character used for each equation in an overlay
+inline char overlayGlyph(std::size_t equation) {
+    const std::string glyphs{ "#@%&$+=~" };
+    return glyphs.at(equation % glyphs.size());
+}
+
+// Draws several grids (eg from createOverlay) in one frame, each with its own overlayGlyph.
+// Points where more than one curve passes are drawn with X
+// IMPORTANT: All grids must have the same settings
+inline void drawOverlay(const std::vector<Grid>& grids, bool thick = false, std::ostream& out = std::cout) {
+    if (grids.size() < 1) return;
+    std::vector<SignPlanes> packed(grids.size());
+    std::vector<const SignPlanes*> signs{ };
+    std::vector<std::vector<std::uint64_t>> curves{ };
+    for (std::size_t i{ 0 }; i < grids.size(); i++) {
+        signs.push_back(&gridSigns(grids[i], packed[i]));
+        curves.push_back(findCurve(*signs[i], thick));
+    }
+    drawFrameRows(grids.at(0), [&](int y, std::string& line) {
+        for (std::size_t i{ 0 }; i < grids.size(); i++) {
+            for (std::size_t column{ 0 }; column < line.size(); column++) {
+                if (signAt(*signs[i], curves[i], (int)column + 1, y) == ' ') continue;
+                line[column] = line[column] == ' ' ? overlayGlyph(i) : 'X';
+            }
+        }
+    }, out);
 }
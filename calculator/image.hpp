@@ -0,0 +1,376 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "grid.hpp"
+
+// Graphs drawn into image files instead of the terminal, at any size.
+// The image is solved in bands of rows, several bands at once on different threads, and each band is
+// written to the file as soon as the bands above it have been. Threads don't get far ahead of the
+// file, so only a few bands are ever in memory, however large the image is.
+// Pixels are drawn with the same rule as drawGrid (see curveAt): a pixel is on the curve if the
+// equation changes sign between it and a neighbour.
+
+enum class ImageFormat {
+    pgm, // greyscale, uncompressed
+    ppm, // colour, uncompressed
+    png, // colour, compressed
+};
+
+struct Image {
+    ImageFormat format{ ImageFormat::png };
+    int width{ 1920 };
+    int height{ 1080 };
+    bool thick{ false }; // also draw the negative side of the curve, see curveAt
+    bool axes{ true };
+    int bandRows{ 64 }; // rows solved at a time by each thread
+    unsigned int threads{ 0 }; // 0 for one per core
+};
+
+// The format to write a file in, from its extension. Returns false if it isn't .pgm, .ppm or .png
+inline bool imageFormat(const std::string& path, ImageFormat& format) {
+    std::string extension{ std::filesystem::path{ path }.extension().string() };
+    for (char& c : extension) c = (char)std::tolower((unsigned char)c);
+    if (extension == ".pgm") format = ImageFormat::pgm;
+    else if (extension == ".ppm") format = ImageFormat::ppm;
+    else if (extension == ".png") format = ImageFormat::png;
+    else return false;
+    return true;
+}
+
+// Colour of each equation's curve (in the order of program.roots), like overlayGlyph
+inline std::array<std::uint8_t, 3> imageColour(std::size_t equation) {
+    const std::array<std::array<std::uint8_t, 3>, 6> colours{ {
+        { 0, 0, 0 }, { 200, 30, 30 }, { 30, 70, 200 }, { 20, 140, 40 }, { 160, 40, 170 }, { 200, 120, 0 }
+    } };
+    return colours.at(equation % colours.size());
+}
+
+// Draws rows [top, bottom) of the image (row 0 is endY) into pixels, one byte per pixel (greyscale)
+// or three (colour), left to right and top to bottom. The window is settings' start and end, the steps
+// come from the image size. The band is solved with a row and column more on every side, so the pixels
+// at its edges have all their neighbours.
+inline void drawImageRows(const Program& program, const Grid& settings, const Image& image, int top, int bottom, std::string& pixels) {
+    const int channels{ image.format == ImageFormat::pgm ? 1 : 3 };
+    const double stepX{ (settings.endX - settings.startX) / (image.width - 1) };
+    const double stepY{ (settings.endY - settings.startY) / (image.height - 1) };
+
+    Grid band{ settings };
+    band.mode = m::equation;
+    band.stepX = stepX;
+    band.stepY = stepY;
+    band.startX = settings.startX - stepX;
+    band.endX = settings.startX + image.width*stepX + stepX/2; // half a step over, so rounding can't lose a column
+    band.startY = settings.endY - bottom*stepY;
+    band.endY = settings.endY - (top - 1)*stepY + stepY/2;
+    std::vector<Grid> grids{ createOverlay(program, band, nullptr, true) };
+    std::vector<std::vector<std::uint64_t>> curves{ };
+    for (const Grid& grid : grids) curves.push_back(findCurve(grid.signs, image.thick));
+
+    pixels.assign((std::size_t)(bottom - top) * image.width * channels, (char)255);
+    for (int row{ top }; row < bottom; row++) {
+        const int y{ bottom - row };
+        const double actualY{ settings.endY - row*stepY };
+        char* pixel{ pixels.data() + (std::size_t)(row - top) * image.width * channels };
+        for (int column{ 0 }; column < image.width; column++, pixel += channels) {
+            const double actualX{ settings.startX + column*stepX };
+            int curve{ -1 };
+            for (std::size_t i{ 0 }; i < grids.size() && curve == -1; i++) {
+                if (signAt(grids[i].signs, curves[i], column + 1, y) != ' ') curve = (int)i;
+            }
+
+            if (curve != -1) {
+                std::array<std::uint8_t, 3> colour{ imageColour(curve) };
+                if (channels == 1) pixel[0] = (char)((colour[0]*77 + colour[1]*150 + colour[2]*29) >> 8);
+                else for (int c{ 0 }; c < 3; c++) pixel[c] = (char)colour[c];
+            } else if (image.axes && (std::abs(actualX) < stepX/2 || std::abs(actualY) < stepY/2)) {
+                for (int c{ 0 }; c < channels; c++) pixel[c] = (char)170;
+            }
+        }
+    }
+}
+
+// Checksums for PNG chunks (CRC-32) and zlib streams (Adler-32)
+inline std::uint32_t crc32(const char* data, std::size_t size, std::uint32_t crc = 0) {
+    static const std::array<std::uint32_t, 256> table{ [] {
+        std::array<std::uint32_t, 256> table{ };
+        for (std::uint32_t n{ 0 }; n < 256; n++) {
+            std::uint32_t c{ n };
+            for (int k{ 0 }; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return table;
+    }() };
+    crc = ~crc;
+    for (std::size_t i{ 0 }; i < size; i++) crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+inline std::uint32_t adler32(const char* data, std::size_t size, std::uint32_t adler = 1) {
+    std::uint32_t a{ adler & 0xffff };
+    std::uint32_t b{ adler >> 16 };
+    while (size > 0) {
+        // 5552 bytes is as many as can be summed before b could overflow
+        std::size_t n{ std::min<std::size_t>(size, 5552) };
+        size -= n;
+        for (; n > 0; n--, data++) {
+            a += (unsigned char)*data;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+// The Adler-32 of two pieces of data one after the other, from the checksum of each (and the second's size)
+inline std::uint32_t adler32Combine(std::uint32_t first, std::uint32_t second, std::size_t secondSize) {
+    const std::uint64_t base{ 65521 };
+    const std::uint64_t remainder{ secondSize % base };
+    std::uint64_t a{ ((first & 0xffff) + (second & 0xffff) + base - 1) % base };
+    std::uint64_t b{ (remainder * (first & 0xffff) + (first >> 16) + (second >> 16) + base - remainder) % base };
+    return (std::uint32_t)((b << 16) | a);
+}
+
+// Writes bits into bytes the way deflate packs them, least significant bit first
+struct BitWriter {
+    std::string bytes{ };
+    std::uint64_t bits{ 0 };
+    int count{ 0 };
+
+    void put(std::uint32_t value, int size) {
+        bits |= (std::uint64_t)value << count;
+        count += size;
+        while (count >= 8) {
+            bytes.push_back((char)(bits & 0xff));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    // Huffman codes are packed most significant bit first
+    void putCode(std::uint32_t code, int size) {
+        std::uint32_t reversed{ 0 };
+        for (int i{ 0 }; i < size; i++) reversed |= ((code >> i) & 1) << (size-1 - i);
+        put(reversed, size);
+    }
+    void align() {
+        if (count > 0) put(0, 8 - count);
+    }
+};
+
+// Compresses data as one deflate block with the fixed Huffman codes, then an empty stored block
+// (a "sync flush") so it ends on a whole byte, and compressed bands can go one after another in one stream.
+// Matches are only looked for one pixel back, one row back, and where the next 3 bytes were last seen,
+// which suits graphs: long runs of background, and rows much like the one above.
+inline std::string deflateFixed(const std::string& data, std::size_t pixel, std::size_t row) {
+    const std::array<int, 29> lengthBase{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const std::array<int, 29> lengthExtra{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const std::array<int, 30> distanceBase{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const std::array<int, 30> distanceExtra{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const std::size_t window{ 32768 };
+    const std::size_t longest{ 258 };
+
+    BitWriter out{ };
+    auto literal{ [&](int symbol) {
+        if (symbol < 144) out.putCode(0x30 + symbol, 8);
+        else if (symbol < 256) out.putCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280) out.putCode(symbol - 256, 7);
+        else out.putCode(0xc0 + symbol - 280, 8);
+    } };
+    out.put(0, 1); // not the last block
+    out.put(1, 2); // fixed Huffman codes
+
+    const unsigned char* bytes{ (const unsigned char*)data.data() };
+    const std::size_t size{ data.size() };
+    std::vector<std::int64_t> seen(1 << 15, -1);
+    auto hash{ [&](std::size_t i) { return ((bytes[i] << 10) ^ (bytes[i+1] << 5) ^ bytes[i+2]) & 0x7fff; } };
+
+    for (std::size_t i{ 0 }; i < size; ) {
+        std::size_t length{ 0 };
+        std::size_t distance{ 0 };
+        std::int64_t last{ i+2 < size ? seen[hash(i)] : -1 };
+        for (const std::size_t back : { pixel, row, last >= 0 ? i - (std::size_t)last : 0 }) {
+            if (back == 0 || back > i || back > window) continue;
+            std::size_t n{ 0 };
+            while (n < longest && i+n < size && bytes[i-back+n] == bytes[i+n]) n++;
+            if (n > length) {
+                length = n;
+                distance = back;
+            }
+        }
+        if (i+2 < size) seen[hash(i)] = (std::int64_t)i;
+
+        if (length < 3) {
+            literal(bytes[i]);
+            i++;
+            continue;
+        }
+        int code{ 28 };
+        while (lengthBase[code] > (int)length) code--;
+        literal(257 + code);
+        out.put(length - lengthBase[code], lengthExtra[code]);
+        code = 29;
+        while (distanceBase[code] > (int)distance) code--;
+        out.putCode(code, 5);
+        out.put(distance - distanceBase[code], distanceExtra[code]);
+        i += length;
+    }
+    literal(256); // end of block
+
+    out.put(0, 1);
+    out.put(0, 2); // stored block
+    out.align();
+    out.bytes += std::string{ "\x00\x00\xff\xff", 4 }; // of 0 bytes
+    return out.bytes;
+}
+
+// Solves and writes a compiled equation's graph (every result of program, see compileTrees) over the window
+// of settings to an image file at path. Returns false if the window or image size are bad, or the file
+// couldn't be written. The file is written next to path, then moved there once it's whole.
+inline bool writeImage(const Program& program, const Grid& settings, const Image& image, const std::string& path, std::string& error) {
+    if (!(settings.startX < settings.endX && settings.startY < settings.endY)) {
+        error = "Grid start positions must be less than end positions";
+        return false;
+    }
+    if (image.width < 2 || image.height < 2 || image.width > (1 << 24) || image.height > (1 << 24)) {
+        error = "Images must be 2 to 16777216 pixels wide and high";
+        return false;
+    }
+    const int channels{ image.format == ImageFormat::pgm ? 1 : 3 };
+    const std::size_t rowBytes{ (std::size_t)image.width * channels };
+
+    std::string temporary{ path + ".tmp" };
+    std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+    if (!file) {
+        error = "Could not write " + temporary;
+        return false;
+    }
+    auto putValue{ [](std::string& out, std::uint32_t value) {
+        for (int shift{ 24 }; shift >= 0; shift -= 8) out.push_back((char)((value >> shift) & 0xff));
+    } };
+    auto putChunk{ [&](const char* type, const std::string& data) {
+        std::string chunk{ };
+        putValue(chunk, data.size());
+        chunk += type;
+        chunk += data;
+        putValue(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        file.write(chunk.data(), chunk.size());
+    } };
+
+    if (image.format == ImageFormat::png) {
+        file.write("\x89PNG\r\n\x1a\n", 8);
+        std::string header{ };
+        putValue(header, image.width);
+        putValue(header, image.height);
+        header += std::string{ "\x08\x02\x00\x00\x00", 5 }; // 8 bit RGB, no interlacing
+        putChunk("IHDR", header);
+        putChunk("IDAT", "\x78\x01"); // the zlib header, in a chunk of its own
+    } else {
+        file << (channels == 1 ? "P5\n" : "P6\n") << image.width << " " << image.height << "\n255\n";
+    }
+
+    // A band ready to be written, and (for PNG) the checksum and size of its uncompressed data
+    struct Band {
+        std::string data{ };
+        std::uint32_t adler{ 1 };
+        std::size_t size{ 0 };
+    };
+    const int bandRows{ std::max(1, image.bandRows) };
+    const int bands{ (image.height + bandRows-1) / bandRows };
+    const int threads{ (int)std::max(1u, std::min<unsigned int>(image.threads > 0 ? image.threads : std::thread::hardware_concurrency(), bands)) };
+    std::mutex mutex{ };
+    std::condition_variable changed{ };
+    std::map<int, Band> done{ };
+    int written{ 0 };
+    bool stopping{ false };
+    std::atomic<int> next{ 0 };
+
+    auto work{ [&] {
+        while (true) {
+            int band{ next++ };
+            if (band >= bands) return;
+            {
+                // Don't get more than a couple of bands per thread ahead of the file
+                std::unique_lock lock{ mutex };
+                changed.wait(lock, [&] { return band < written + 2*threads || stopping; });
+                if (stopping) return;
+            }
+            Band out{ };
+            try {
+                int top{ band * bandRows };
+                drawImageRows(program, settings, image, top, std::min(image.height, top + bandRows), out.data);
+                if (image.format == ImageFormat::png) {
+                    // Every row starts with its filter type, 0 (none)
+                    std::string rows{ };
+                    rows.reserve(out.data.size() + out.data.size()/rowBytes);
+                    for (std::size_t row{ 0 }; row < out.data.size(); row += rowBytes) {
+                        rows.push_back('\0');
+                        rows.append(out.data, row, rowBytes);
+                    }
+                    out.size = rows.size();
+                    out.adler = adler32(rows.data(), rows.size());
+                    out.data = deflateFixed(rows, channels, rowBytes + 1);
+                }
+            } catch (const std::bad_alloc&) {
+                out.data.clear();
+            }
+            std::lock_guard lock{ mutex };
+            done[band] = std::move(out);
+            changed.notify_all();
+        }
+    } };
+    std::vector<std::thread> workers{ };
+    for (int i{ 0 }; i < threads; i++) workers.emplace_back(work);
+
+    std::uint32_t adler{ 1 };
+    for (int band{ 0 }; band < bands; band++) {
+        Band out{ };
+        {
+            std::unique_lock lock{ mutex };
+            changed.wait(lock, [&] { return done.contains(band); });
+            out = std::move(done.at(band));
+            done.erase(band);
+        }
+        if (out.data.size() == 0) {
+            error = "Image is too large";
+        } else if (image.format == ImageFormat::png) {
+            adler = adler32Combine(adler, out.adler, out.size);
+            putChunk("IDAT", out.data);
+        } else {
+            file.write(out.data.data(), out.data.size());
+        }
+        if (!file) error = "Could not write " + temporary;
+
+        std::lock_guard lock{ mutex };
+        written++;
+        if (error.size() > 0) stopping = true;
+        changed.notify_all();
+        if (stopping) break;
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    if (error.size() == 0 && image.format == ImageFormat::png) {
+        // The last (empty) block, then the checksum of everything
+        std::string end{ "\x03\x00", 2 };
+        putValue(end, adler);
+        putChunk("IDAT", end);
+        putChunk("IEND", "");
+    }
+    file.close();
+    if (error.size() == 0 && !file) error = "Could not write " + temporary;
+    std::error_code renamed{ };
+    if (error.size() == 0) std::filesystem::rename(temporary, path, renamed);
+    if (error.size() > 0 || renamed) {
+        std::filesystem::remove(temporary, renamed);
+        if (error.size() == 0) error = "Could not write " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,281 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <thread>
+#include "grid.hpp"
+
+// Integrals of compiled equations, by adaptive Gauss-Kronrod quadrature.
+// Each piece (an interval, or a rectangle in 2-D) is solved at the 15 Kronrod nodes (15x15 in 2-D),
+// and the 7 Gauss nodes among them give a second, less accurate integral: the difference is the piece's
+// error estimate. Pieces with more than their share of the error are halved until the total error is
+// small enough. Every node of a round is solved as one batch (see solveBatch), split between threads.
+
+// The Kronrod nodes on [-1, 1] (and their negatives), 0 last, and their weights.
+// Odd indices are also the Gauss nodes, with gaussWeights
+const std::array<double, 8> kronrodNodes{
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851, 0.864864423359769072789712788640926,
+    0.741531185599394439863864773280788, 0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0
+};
+const std::array<double, 8> kronrodWeights{
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204, 0.104790010322250183839876322541518,
+    0.140653259715525918745189590510238, 0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+const std::array<double, 8> gaussWeights{
+    0, 0.129484966168869693270611432679082, 0, 0.279705391489276667901467771423780,
+    0, 0.381830050505118944950369775488975, 0, 0.417959183673469387755102040816327
+};
+
+// The 15 Kronrod nodes (scaled to [a, b]) and their Kronrod and Gauss weights (0 if not a Gauss node)
+struct Nodes {
+    std::array<double, 15> at{ };
+    std::array<double, 15> kronrod{ };
+    std::array<double, 15> gauss{ };
+};
+inline Nodes kronrodNodesOn(double a, double b) {
+    Nodes nodes{ };
+    const double middle{ (a + b) / 2 };
+    const double half{ (b - a) / 2 };
+    for (int i{ 0 }; i < 15; i++) {
+        int k{ i < 8 ? i : 14 - i }; // 0..7 then 6..0
+        double sign{ i < 7 ? -1.0 : 1.0 };
+        nodes.at[i] = middle + sign * half * kronrodNodes[k];
+        nodes.kronrod[i] = half * kronrodWeights[k];
+        nodes.gauss[i] = half * gaussWeights[k];
+    }
+    return nodes;
+}
+
+struct Integral {
+    double value{ 0 };
+    double error{ 0 }; // estimated, see above
+    std::size_t evaluations{ 0 };
+    std::size_t pieces{ 0 };
+    bool converged{ false }; // false if it ran out of evaluations, or the integral may not be finite (see refinePieces)
+};
+
+// Solves a program's first result at every lane of batch, as one batch per thread
+inline std::vector<double> solveLanesParallel(const Program& program, const Batch& batch, unsigned int threads) {
+    std::vector<double> out(batch.size);
+    const std::size_t smallest{ 4096 }; // lanes per thread, so small rounds don't pay for threads
+    std::size_t parts{ std::max<std::size_t>(1, std::min<std::size_t>(threads, batch.size / smallest)) };
+    auto solvePart{ [&](std::size_t part) {
+        std::size_t begin{ batch.size * part / parts };
+        std::size_t end{ batch.size * (part+1) / parts };
+        Batch slice{ .size = end - begin, .variables = batch.variables, .precision = batch.precision };
+        for (const auto& [variable, values] : batch.varying) {
+            slice.varying[variable].assign(values.begin() + begin, values.begin() + end);
+        }
+        Lanes lanes{ };
+        solveBatch(program, slice, lanes);
+        for (std::size_t lane{ 0 }; lane < slice.size; lane++) out[begin + lane] = laneValue(lanes, program.roots[0], lane);
+    } };
+    std::vector<std::thread> workers{ };
+    for (std::size_t part{ 1 }; part < parts; part++) workers.emplace_back(solvePart, part);
+    solvePart(0);
+    for (std::thread& worker : workers) worker.join();
+    return out;
+}
+
+// How adaptive quadrature stops: when the error estimate is below tolerance (relative to the integral,
+// or absolute if that's larger), or after most evaluations of the integrand
+struct Quadrature {
+    double tolerance{ 1e-10 };
+    double absolute{ 1e-12 };
+    std::size_t most{ 1 << 24 };
+    unsigned int threads{ 0 }; // 0 for one per core
+    p precision{ p::exact };
+};
+
+// How many times in a row a piece can be halved without its value getting any smaller before the
+// integral is taken to not be finite there (an integrable piece's value goes to 0 as it shrinks,
+// but 1/x's stays the same, and 1/x^2's doubles)
+const int growingLimit{ 16 };
+
+// Splits the pieces with more than their share of the error in two, with split(piece, pieces)
+// (which adds copies of the piece, made into its halves, to pieces), until the integral is within
+// the quadrature's tolerance. solve(first) solves all the pieces from first onwards, and sets their
+// narrow if their nodes are so close together that they can't be told apart (eg a pole was halved
+// down to the width of a double, where the error estimate means nothing).
+// Narrow pieces, and pieces whose value keeps growing as they're halved, are stuck: they aren't
+// split again, and the integral isn't converged. Returns the integral of the pieces
+template <typename Piece, typename Solve, typename Split>
+Integral refinePieces(std::vector<Piece>& pieces, const Quadrature& quadrature, std::size_t evaluationsPerPiece, Solve solve, Split split) {
+    Integral out{ };
+    solve(0);
+    out.evaluations = pieces.size() * evaluationsPerPiece;
+    while (true) {
+        out.value = 0;
+        out.error = 0;
+        bool stuck{ false };
+        for (const Piece& piece : pieces) {
+            out.value += piece.value;
+            out.error += piece.error;
+            stuck = stuck || piece.narrow || piece.growing >= growingLimit;
+        }
+        double target{ std::max(quadrature.absolute, quadrature.tolerance * std::abs(out.value)) };
+        out.converged = out.error <= target && !stuck;
+        if (out.error <= target || !std::isfinite(out.error)) break;
+
+        // Pieces with more than their share of the error, or at least the worst one
+        double share{ target / pieces.size() };
+        std::vector<Piece> next{ };
+        std::vector<Piece> splitting{ };
+        for (const Piece& piece : pieces) {
+            bool canSplit{ !piece.narrow && piece.growing < growingLimit };
+            (canSplit && piece.error > share ? splitting : next).push_back(piece);
+        }
+        if (splitting.size() == 0) break;
+        if (out.evaluations + 2*splitting.size()*evaluationsPerPiece > quadrature.most) break;
+
+        std::size_t first{ next.size() };
+        for (const Piece& piece : splitting) split(piece, next);
+        pieces = std::move(next);
+        // The halves still have their whole piece's value until they're solved
+        std::vector<double> whole{ };
+        for (std::size_t i{ first }; i < pieces.size(); i++) whole.push_back(pieces[i].value);
+        solve(first);
+        for (std::size_t i{ first }; i < pieces.size(); i++) {
+            Piece& piece{ pieces[i] };
+            bool smaller{ std::abs(piece.value) < std::abs(whole[i - first]) * (1 - 1e-9) };
+            piece.growing = smaller ? 0 : piece.growing + 1;
+        }
+        out.evaluations += (pieces.size() - first) * evaluationsPerPiece;
+    }
+    out.pieces = pieces.size();
+    return out;
+}
+
+// True if any of the nodes are the same (the piece is too narrow for its nodes to be told apart).
+// Nodes go down instead of up when integrating from a larger bound to a smaller one
+inline bool nodesTooClose(const Nodes& nodes) {
+    for (int i{ 0 }; i+1 < 15; i++) {
+        if (!(std::abs(nodes.at[i+1] - nodes.at[i]) > 0)) return true;
+    }
+    return false;
+}
+
+// Integrates a compiled equation's first result over x from a to b (with any other variables 0)
+inline Integral integrate(const Program& program, double a, double b, const Quadrature& quadrature = { }) {
+    if (a == b) return { .converged = true };
+    struct Piece {
+        double a{ };
+        double b{ };
+        double value{ };
+        double error{ };
+        bool narrow{ false };
+        int growing{ 0 }; // times in a row its value didn't get smaller when halved
+    };
+    const unsigned int threads{ quadrature.threads > 0 ? quadrature.threads : std::max(1u, std::thread::hardware_concurrency()) };
+    std::vector<Piece> pieces{ };
+    const int start{ 16 };
+    for (int i{ 0 }; i < start; i++) pieces.push_back({ a + (b - a)*i/start, a + (b - a)*(i+1)/start });
+
+    auto solve{ [&](std::size_t first) {
+        Batch batch{ .size = (pieces.size() - first) * 15, .precision = quadrature.precision };
+        std::vector<double>& xs{ batch.varying['x'] };
+        for (std::size_t i{ first }; i < pieces.size(); i++) {
+            Nodes nodes{ kronrodNodesOn(pieces[i].a, pieces[i].b) };
+            xs.insert(xs.end(), nodes.at.begin(), nodes.at.end());
+        }
+        std::vector<double> values{ solveLanesParallel(program, batch, threads) };
+        for (std::size_t i{ first }; i < pieces.size(); i++) {
+            Nodes nodes{ kronrodNodesOn(pieces[i].a, pieces[i].b) };
+            double kronrod{ 0 };
+            double gauss{ 0 };
+            for (int k{ 0 }; k < 15; k++) {
+                double value{ values[(i - first)*15 + k] };
+                kronrod += nodes.kronrod[k] * value;
+                gauss += nodes.gauss[k] * value;
+            }
+            pieces[i].value = kronrod;
+            pieces[i].error = std::abs(kronrod - gauss);
+            pieces[i].narrow = nodesTooClose(nodes);
+        }
+    } };
+    auto split{ [](const Piece& piece, std::vector<Piece>& out) {
+        Piece first{ piece };
+        Piece second{ piece };
+        first.b = second.a = (piece.a + piece.b) / 2;
+        out.push_back(first);
+        out.push_back(second);
+    } };
+    return refinePieces(pieces, quadrature, 15, solve, split);
+}
+
+// Integrates a compiled equation's first result over the window of settings (x from startX to endX,
+// y from startY to endY). Rectangles are halved across x or y, whichever the Kronrod and Gauss sums
+// disagree about most
+inline Integral integrateWindow(const Program& program, const Grid& settings, const Quadrature& quadrature = { }) {
+    struct Piece {
+        double startX{ };
+        double endX{ };
+        double startY{ };
+        double endY{ };
+        double value{ };
+        double error{ };
+        bool acrossX{ true }; // halve across x next
+        bool narrow{ false }; // across the way it'd be halved
+        int growing{ 0 };
+    };
+    const unsigned int threads{ quadrature.threads > 0 ? quadrature.threads : std::max(1u, std::thread::hardware_concurrency()) };
+    std::vector<Piece> pieces{ };
+    const int start{ 4 };
+    for (int i{ 0 }; i < start; i++) {
+        for (int j{ 0 }; j < start; j++) {
+            pieces.push_back({
+                settings.startX + (settings.endX - settings.startX)*i/start, settings.startX + (settings.endX - settings.startX)*(i+1)/start,
+                settings.startY + (settings.endY - settings.startY)*j/start, settings.startY + (settings.endY - settings.startY)*(j+1)/start
+            });
+        }
+    }
+
+    auto solve{ [&](std::size_t first) {
+        Batch batch{ .size = (pieces.size() - first) * 225, .precision = quadrature.precision };
+        std::vector<double>& xs{ batch.varying['x'] };
+        std::vector<double>& ys{ batch.varying['y'] };
+        for (std::size_t i{ first }; i < pieces.size(); i++) {
+            Nodes x{ kronrodNodesOn(pieces[i].startX, pieces[i].endX) };
+            Nodes y{ kronrodNodesOn(pieces[i].startY, pieces[i].endY) };
+            for (int a{ 0 }; a < 15; a++) {
+                for (int b{ 0 }; b < 15; b++) {
+                    xs.push_back(x.at[a]);
+                    ys.push_back(y.at[b]);
+                }
+            }
+        }
+        std::vector<double> values{ solveLanesParallel(program, batch, threads) };
+        for (std::size_t i{ first }; i < pieces.size(); i++) {
+            Nodes x{ kronrodNodesOn(pieces[i].startX, pieces[i].endX) };
+            Nodes y{ kronrodNodesOn(pieces[i].startY, pieces[i].endY) };
+            double kronrod{ 0 };
+            double gauss{ 0 };
+            double gaussX{ 0 }; // Gauss across x, Kronrod across y
+            double gaussY{ 0 };
+            for (int a{ 0 }; a < 15; a++) {
+                for (int b{ 0 }; b < 15; b++) {
+                    double value{ values[(i - first)*225 + a*15 + b] };
+                    kronrod += x.kronrod[a] * y.kronrod[b] * value;
+                    gauss += x.gauss[a] * y.gauss[b] * value;
+                    gaussX += x.gauss[a] * y.kronrod[b] * value;
+                    gaussY += x.kronrod[a] * y.gauss[b] * value;
+                }
+            }
+            pieces[i].value = kronrod;
+            pieces[i].error = std::abs(kronrod - gauss);
+            pieces[i].acrossX = std::abs(kronrod - gaussX) >= std::abs(kronrod - gaussY);
+            pieces[i].narrow = nodesTooClose(pieces[i].acrossX ? x : y);
+        }
+    } };
+    auto split{ [](const Piece& piece, std::vector<Piece>& out) {
+        Piece first{ piece };
+        Piece second{ piece };
+        if (piece.acrossX) first.endX = second.startX = (piece.startX + piece.endX) / 2;
+        else first.endY = second.startY = (piece.startY + piece.endY) / 2;
+        out.push_back(first);
+        out.push_back(second);
+    } };
+    return refinePieces(pieces, quadrature, 225, solve, split);
+}
@@ -0,0 +1,269 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <numbers>
+#include <thread>
+#include "compile.hpp"
+
+// Where two equations' curves cross (see :intersect).
+// Both are compiled into one program (see compileTrees), and solved over whole boxes of the window at
+// once with interval arithmetic: if either's range over a box doesn't include 0, that curve doesn't
+// pass through the box, so the box is dropped. Other boxes are split in 4 until they're about a cell
+// across, and Newton's method (with the Jacobian from central differences) is started from the middle
+// of each to find the crossing exactly. The window is split into tiles, searched by as many threads
+// as there are.
+
+// Every value an instruction can have over a box. Bounds that couldn't be worked out are infinite
+struct Interval {
+    double low{ -INFINITY };
+    double high{ INFINITY };
+
+    bool hasZero() const { return !(low > 0 || high < 0); }
+    bool point() const { return low == high; }
+};
+
+inline Interval intervalHull(std::initializer_list<double> values) {
+    Interval out{ INFINITY, -INFINITY };
+    for (const double value : values) {
+        if (std::isnan(value)) return { };
+        out.low = std::min(out.low, value);
+        out.high = std::max(out.high, value);
+    }
+    return out;
+}
+
+// A function that only goes up (or only down), over the part of value that's between low and high
+template <typename F>
+Interval intervalMonotonic(F function, Interval value, double low = -INFINITY, double high = INFINITY) {
+    if (value.high < low || value.low > high) return { };
+    return intervalHull({ function(std::max(value.low, low)), function(std::min(value.high, high)) });
+}
+
+// SIN (shift 0) or COS (shift pi/2): -1 or 1 wherever the interval passes a trough or a peak
+inline Interval intervalSine(Interval value, double shift) {
+    if (!std::isfinite(value.low) || !std::isfinite(value.high) || value.high - value.low >= 2*std::numbers::pi) return { -1, 1 };
+    Interval out{ intervalHull({ std::sin(value.low + shift), std::sin(value.high + shift) }) };
+    // Peaks are at pi/2 + 2k pi, troughs at -pi/2 + 2k pi
+    double peak{ std::ceil((value.low + shift - std::numbers::pi/2) / (2*std::numbers::pi)) * 2*std::numbers::pi + std::numbers::pi/2 };
+    if (peak <= value.high + shift) out.high = 1;
+    double trough{ std::ceil((value.low + shift + std::numbers::pi/2) / (2*std::numbers::pi)) * 2*std::numbers::pi - std::numbers::pi/2 };
+    if (trough <= value.high + shift) out.low = -1;
+    return out;
+}
+
+inline Interval intervalFunction(f function, Interval value) {
+    switch (function) {
+        case f::sin: return intervalSine(value, 0);
+        case f::cos: return intervalSine(value, std::numbers::pi/2);
+        case f::tan: {
+            // Unless there's an asymptote in between
+            if (!std::isfinite(value.low) || !std::isfinite(value.high)) return { };
+            double pole{ std::ceil((value.low - std::numbers::pi/2) / std::numbers::pi) * std::numbers::pi + std::numbers::pi/2 };
+            if (pole <= value.high) return { };
+            return intervalHull({ std::tan(value.low), std::tan(value.high) });
+        }
+        case f::asin: return intervalMonotonic([](double v) { return std::asin(v); }, value, -1, 1);
+        case f::acos: return intervalMonotonic([](double v) { return std::acos(v); }, value, -1, 1);
+        case f::atan: return intervalMonotonic([](double v) { return std::atan(v); }, value);
+        case f::sqrt: return intervalMonotonic([](double v) { return std::sqrt(v); }, value, 0);
+        case f::cbrt: return intervalMonotonic([](double v) { return std::cbrt(v); }, value);
+        case f::log:  return intervalMonotonic([](double v) { return std::log10(v); }, value, 0);
+        case f::lb:   return intervalMonotonic([](double v) { return std::log2(v); }, value, 0);
+        case f::ln:   return intervalMonotonic([](double v) { return std::log(v); }, value, 0);
+        case f::abs:
+            if (value.low >= 0) return value;
+            if (value.high <= 0) return { -value.high, -value.low };
+            return { 0, std::max(-value.low, value.high) };
+        case f::sign: return { value.low > 0 ? 1.0 : value.low == 0 ? 0.0 : -1.0, value.high > 0 ? 1.0 : value.high == 0 ? 0.0 : -1.0 };
+        case f::even: return { -2, 2 };
+        case f::pi:
+        case f::e: {
+            // PI(v) is pi times v, except PI(0) is pi
+            double constant{ function == f::pi ? std::numbers::pi : std::numbers::e };
+            Interval out{ intervalHull({ constant * value.low, constant * value.high }) };
+            if (value.hasZero()) out = { std::min(out.low, constant), std::max(out.high, constant) };
+            return out;
+        }
+        default: return { 0, 0 };
+    }
+}
+
+inline Interval intervalOperation(const Instruction& ins, Interval left, Interval right) {
+    switch (ins.operation) {
+        case o::add: return intervalHull({ left.low + right.low, left.high + right.high });
+        case o::subtract: return intervalHull({ left.low - right.high, left.high - right.low });
+        case o::negate: return { -right.high, -right.low };
+        case o::multiply:
+            // 0 times an infinite bound is 0 here, since the bound is only as far as the interval goes
+            if (left.point() && left.low == 0) return { 0, 0 };
+            if (right.point() && right.low == 0) return { 0, 0 };
+            return intervalHull({ left.low*right.low, left.low*right.high, left.high*right.low, left.high*right.high });
+        case o::divide:
+            if (right.hasZero()) return { };
+            return intervalHull({ left.low/right.low, left.low/right.high, left.high/right.low, left.high/right.high });
+        case o::modulo: {
+            // Smaller than the divisor, with the sign of the dividend
+            double most{ std::max(std::abs(right.low), std::abs(right.high)) };
+            if (std::isnan(most)) return { };
+            return { left.low >= 0 ? 0 : -most, left.high <= 0 ? 0 : most };
+        }
+        case o::exponent: {
+            if (right.point() && right.low == std::round(right.low) && std::abs(right.low) <= 64) {
+                int power{ (int)right.low };
+                if (power == 0) return { 1, 1 };
+                if (power < 0) {
+                    if (left.hasZero()) return { };
+                    left = intervalOperation({ .operation = o::divide }, { 1, 1 }, left);
+                    power = -power;
+                }
+                Interval out{ intervalHull({ std::pow(left.low, power), std::pow(left.high, power) }) };
+                if (power % 2 == 0 && left.hasZero()) out.low = 0;
+                return out;
+            }
+            // Only positive bases have real powers, and those only go up or down in either
+            if (left.low <= 0) return { };
+            return intervalHull({ std::pow(left.low, right.low), std::pow(left.low, right.high),
+                std::pow(left.high, right.low), std::pow(left.high, right.high) });
+        }
+        case o::function: return intervalFunction(ins.function, right);
+        default: return { 0, 0 };
+    }
+}
+
+// Solves every instruction of a program over a box (x and y in their intervals, other variables as given)
+inline void solveIntervals(const Program& program, const Variables& variables, Interval x, Interval y, std::vector<Interval>& registers) {
+    registers.resize(program.code.size());
+    for (std::size_t i{ 0 }; i < program.code.size(); i++) {
+        const Instruction& ins{ program.code[i] };
+        if (ins.isVariable) {
+            double value{ variables[ins.variable - 'a'] };
+            registers[i] = ins.variable == 'x' ? x : ins.variable == 'y' ? y : Interval{ value, value };
+        } else if (ins.operation == o::none) {
+            registers[i] = { ins.value, ins.value };
+        } else {
+            registers[i] = intervalOperation(ins,
+                ins.left == -1 ? Interval{ 0, 0 } : registers[ins.left],
+                ins.right == -1 ? Interval{ 0, 0 } : registers[ins.right]);
+        }
+    }
+}
+
+struct Intersections {
+    std::vector<std::array<double, 2>> points{ }; // (x, y), in order of x
+    std::size_t boxes{ 0 }; // solved with intervals
+    std::size_t solved{ 0 }; // values solved for Newton's method
+};
+
+// Finds where the curves of a program's first two results (both 0 = ...) cross in the window of settings.
+// Crossings closer than a thousandth of a cell are counted once. threads is 0 for one per core
+inline Intersections findIntersections(const Program& program, const Grid& settings, unsigned int threads = 0) {
+    Intersections out{ };
+    if (program.roots.size() < 2) return out;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    const double width{ settings.endX - settings.startX };
+    const double height{ settings.endY - settings.startY };
+    // Boxes are split down to a cell, or a 512th of the window for very fine windows (Newton's method
+    // doesn't need them any smaller)
+    const double smallestX{ std::max(settings.stepX, width / 512) };
+    const double smallestY{ std::max(settings.stepY, height / 512) };
+    const int tiles{ 16 };
+    std::atomic<int> next{ 0 };
+    std::mutex mutex{ };
+
+    auto work{ [&] {
+        Variables variables{ };
+        std::vector<double> registers(program.code.size());
+        std::vector<Interval> intervals{ };
+        std::vector<std::array<double, 2>> found{ };
+        std::size_t boxes{ 0 };
+        std::size_t solved{ 0 };
+
+        // Both results at a point, in cells from the window's start
+        auto at{ [&](double u, double v) {
+            variables['x'-'a'] = settings.startX + u*settings.stepX;
+            variables['y'-'a'] = settings.startY + v*settings.stepY;
+            solveProgram(program, variables, registers);
+            solved++;
+            return std::array<double, 2>{ registers[program.roots[0]], registers[program.roots[1]] };
+        } };
+        auto newton{ [&](double u, double v, double boxU, double boxV) {
+            const double h{ 1.0 / 1024 };
+            const double startU{ u };
+            const double startV{ v };
+            for (int i{ 0 }; i < 32; i++) {
+                auto [f, g]{ at(u, v) };
+                auto [fRight, gRight]{ at(u + h, v) };
+                auto [fLeft, gLeft]{ at(u - h, v) };
+                auto [fUp, gUp]{ at(u, v + h) };
+                auto [fDown, gDown]{ at(u, v - h) };
+                double fu{ (fRight - fLeft) / (2*h) };
+                double fv{ (fUp - fDown) / (2*h) };
+                double gu{ (gRight - gLeft) / (2*h) };
+                double gv{ (gUp - gDown) / (2*h) };
+                double determinant{ fu*gv - fv*gu };
+                if (!std::isfinite(determinant) || determinant == 0 || !std::isfinite(f) || !std::isfinite(g)) return;
+                double du{ (f*gv - g*fv) / determinant };
+                double dv{ (g*fu - f*gu) / determinant };
+                u -= du;
+                v -= dv;
+                // Wandered off to a crossing another box will find
+                if (std::abs(u - startU) > boxU || std::abs(v - startV) > boxV) return;
+                if (du*du + dv*dv < 1e-18) {
+                    found.push_back({ settings.startX + u*settings.stepX, settings.startY + v*settings.stepY });
+                    return;
+                }
+            }
+        } };
+        auto search{ [&](auto& self, double x0, double x1, double y0, double y1) -> void {
+            solveIntervals(program, variables, { x0, x1 }, { y0, y1 }, intervals);
+            boxes++;
+            if (!intervals[program.roots[0]].hasZero() || !intervals[program.roots[1]].hasZero()) return;
+            if (x1 - x0 <= smallestX && y1 - y0 <= smallestY) {
+                double boxU{ (x1 - x0) / settings.stepX };
+                double boxV{ (y1 - y0) / settings.stepY };
+                newton(((x0 + x1)/2 - settings.startX) / settings.stepX, ((y0 + y1)/2 - settings.startY) / settings.stepY, boxU, boxV);
+                return;
+            }
+            double middleX{ x1 - x0 > smallestX ? (x0 + x1) / 2 : x1 };
+            double middleY{ y1 - y0 > smallestY ? (y0 + y1) / 2 : y1 };
+            self(self, x0, middleX, y0, middleY);
+            if (middleX < x1) self(self, middleX, x1, y0, middleY);
+            if (middleY < y1) self(self, x0, middleX, middleY, y1);
+            if (middleX < x1 && middleY < y1) self(self, middleX, x1, middleY, y1);
+        } };
+
+        while (true) {
+            int tile{ next++ };
+            if (tile >= tiles*tiles) break;
+            int i{ tile % tiles };
+            int j{ tile / tiles };
+            search(search, settings.startX + width*i/tiles, settings.startX + width*(i+1)/tiles,
+                settings.startY + height*j/tiles, settings.startY + height*(j+1)/tiles);
+        }
+        std::lock_guard lock{ mutex };
+        out.points.insert(out.points.end(), found.begin(), found.end());
+        out.boxes += boxes;
+        out.solved += solved;
+    } };
+    std::vector<std::thread> workers{ };
+    for (unsigned int i{ 1 }; i < threads; i++) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+
+    // Neighbouring boxes often find the same crossing, and Newton's method can land just off the window
+    std::sort(out.points.begin(), out.points.end());
+    std::vector<std::array<double, 2>> unique{ };
+    for (const auto& point : out.points) {
+        if (point[0] < settings.startX || point[0] > settings.endX || point[1] < settings.startY || point[1] > settings.endY) continue;
+        bool seen{ false };
+        for (auto other{ unique.rbegin() }; other != unique.rend() && point[0] - (*other)[0] <= settings.stepX / 1000; other++) {
+            seen = seen || std::abs(point[1] - (*other)[1]) <= settings.stepY / 1000;
+        }
+        if (!seen) unique.push_back(point);
+    }
+    out.points = std::move(unique);
+    return out;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <new>
+#include <sstream>
+#include "grid.hpp"
+#include "function.hpp"
+#include "trace.hpp"
+#include "polynomial.hpp"
+#include "define.hpp"
+
+// The calculator as a library: parse, compile, then solve points, batches or grids.
+// None of these print. Problems are reported by returning false, with the reason in error.
+// Nothing here keeps any state between calls, so they can all be called from several threads
+// at once, as long as each thread has its own outputs. Programs and trees are only read.
+
+// Turns messages written to a log into an error
+inline std::string logAsError(const std::ostringstream& log, const std::string& otherwise) {
+    std::string error{ log.str() };
+    while (error.size() > 0 && error.back() == '\n') error.pop_back();
+    return error.size() > 0 ? error : otherwise;
+}
+
+// Parses an equation (the part after "0 = "), with any user-defined functions inlined
+inline bool parseEquation(const std::string& equation, TreeItem& tree, std::string& error, const Definitions& definitions = { }) {
+    std::ostringstream log{ };
+    if (!parseSource(equation, tree, log)) {
+        error = logAsError(log, "Could not parse " + equation);
+        return false;
+    }
+    return inlineFunctions(tree, definitions, error);
+}
+
+// Compiles a parsed equation. Unknown functions are an error here,
+// but program is still usable (they solve as 0, same as compileTree)
+inline bool compileEquation(const TreeItem& tree, Program& program, std::string& error) {
+    std::ostringstream log{ };
+    program = compileTree(tree, log);
+    if (log.tellp() > 0) {
+        error = logAsError(log, "Could not compile equation");
+        return false;
+    }
+    return true;
+}
+
+// Compiles several parsed equations into one program, with one root each (see compileTrees)
+inline bool compileEquations(const std::vector<TreeItem>& trees, Program& program, std::string& error) {
+    std::ostringstream log{ };
+    program = compileTrees(trees, log);
+    if (log.tellp() > 0) {
+        error = logAsError(log, "Could not compile equations");
+        return false;
+    }
+    return true;
+}
+
+// Solves a compiled equation at one point.
+// registers is only used to solve in, keep one per thread to avoid allocating every call
+inline double solvePoint(const Program& program, const Variables& variables, std::vector<double>& registers) {
+    registers.resize(program.code.size());
+    solveProgram(program, variables, registers);
+    return registers[program.roots.at(0)];
+}
+
+// Solves a compiled equation for every lane of a batch. out gets one value per lane
+inline bool solvePoints(const Program& program, const Batch& batch, std::vector<double>& out, std::string& error) {
+    for (const auto& [variable, values] : batch.varying) {
+        if (variable < 'a' || variable > 'z') {
+            error = std::string{ "Variables must be a-z, not " } + variable;
+            return false;
+        }
+        if (values.size() != batch.size) {
+            error = std::string{ "Variable " } + variable + " has " + std::to_string(values.size())
+                + " values, the batch has " + std::to_string(batch.size) + " lanes";
+            return false;
+        }
+    }
+    Lanes lanes{ };
+    solveBatch(program, batch, lanes);
+    out.resize(batch.size);
+    for (std::size_t lane{ 0 }; lane < batch.size; lane++) {
+        out[lane] = laneValue(lanes, program.roots.at(0), lane);
+    }
+    return true;
+}
+
+// Checks a grid's window can be solved
+inline bool checkWindow(const Grid& settings, std::string& error) {
+    if (!(settings.startX < settings.endX && settings.startY < settings.endY)) {
+        error = "Grid start positions must be less than end positions";
+        return false;
+    }
+    if (!(settings.stepX > 0 && settings.stepY > 0)) {
+        error = "Grid steps must be greater than 0";
+        return false;
+    }
+    if ((settings.mode == m::parametric || settings.mode == m::polar) && !(settings.startT < settings.endT)) {
+        error = "startT must be less than endT";
+        return false;
+    }
+    return true;
+}
+
+// Solves a compiled equation over a grid, with the window, precision and mode of settings
+// (for m::function, the compiled function is graphed as y = f(x), see createCurve, and for
+// m::parametric and m::polar, its results are x(t) and y(t) or r(t), see createParametric.
+// Equations are traced with e::trace, see createTrace, and solved column by column with e::roots if
+// they're polynomials in y, see createRoots).
+// Only e::grid (the default) gives the equation's value at every point in out.points: the other
+// engines (and modes) give curve grids, with the stretches of each column the curve covers. They're
+// for drawing (see drawCurve), so callers that want the values should leave the engine as it is.
+// Callers that only draw the grid can pass signsOnly, so grids solved point by point only keep
+// each point's sign (in out.signs, see createOverlay) instead of its value.
+// Setting cancel (from another thread) stops it early, returning false
+inline bool solveGrid(const Program& program, const Grid& settings, Grid& out, std::string& error, const std::atomic<bool>* cancel = nullptr, bool signsOnly = false) {
+    if (!checkWindow(settings, error)) return false;
+    if (settings.mode == m::parametric && program.roots.size() < 2) {
+        error = "Parametric curves need x(t) and y(t)";
+        return false;
+    }
+    Program coefficients{ };
+    try {
+        if (settings.mode == m::function) out = createCurve(program, settings, cancel);
+        else if (settings.mode == m::parametric || settings.mode == m::polar) out = createParametric(program, settings, cancel);
+        else if (settings.engine == e::trace) out = createTrace(program, settings, cancel);
+        else if (settings.engine == e::roots && polynomialInY(program, coefficients)) out = createRoots(coefficients, settings, cancel);
+        else out = std::move(createOverlay(program, settings, cancel, signsOnly).at(0));
+    } catch (const std::bad_alloc&) {
+        error = "Grid is too large";
+        return false;
+    }
+    if (cancel != nullptr && *cancel) {
+        error = "Cancelled";
+        return false;
+    }
+    return true;
+}
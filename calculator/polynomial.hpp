@@ -0,0 +1,251 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include "function.hpp"
+
+// Equations that are polynomials in y, eg x^2 + y^2 - 25 or y^3 - x*y + 1, of degree 4 at most.
+// Their coefficients only depend on x, so each column is solved by finding the roots of a polynomial,
+// instead of solving every point of it: the curve is exactly where the roots are.
+// See e::roots.
+
+// The coefficients of a polynomial in y, lowest power first, as instructions of a Program (-1 for 0)
+using Polynomial = std::vector<int>;
+
+// Writes a compiled equation's (first) result as a polynomial in y: a program with one result per coefficient
+// (lowest power first), made of the parts of the equation that don't read y. Returns false if the
+// equation isn't a polynomial in y (y inside a function, divided by, or to a power that isn't a
+// whole number), is one of degree more than most, or doesn't read y at all.
+inline bool polynomialInY(const Program& program, Program& coefficients, int most = 4) {
+    coefficients = { };
+    if (program.roots.size() == 0) return false;
+    Seen seen{ };
+    std::map<int, int> copied{ };
+    auto add{ [&](Instruction ins) { return addInstruction(coefficients, ins, seen); } };
+    // An instruction that doesn't read y, as it is
+    auto copy{ [&](auto& self, int i) -> int {
+        if (i == -1) return -1;
+        auto found{ copied.find(i) };
+        if (found != copied.end()) return found->second;
+        Instruction ins{ program.code[i] };
+        ins.reads = 0;
+        ins.left = self(self, ins.left);
+        ins.right = self(self, ins.right);
+        return copied[i] = add(ins);
+    } };
+    auto operation{ [&](o op, int left, int right) { return add({ .operation = op, .left = left, .right = right }); } };
+    auto sum{ [&](int a, int b) { return a == -1 ? b : b == -1 ? a : operation(o::add, a, b); } };
+    auto product{ [&](const Polynomial& a, const Polynomial& b) {
+        Polynomial out(a.size() + b.size() - 1, -1);
+        for (std::size_t i{ 0 }; i < a.size(); i++) {
+            for (std::size_t j{ 0 }; j < b.size(); j++) {
+                if (a[i] != -1 && b[j] != -1) out[i+j] = sum(out[i+j], operation(o::multiply, a[i], b[j]));
+            }
+        }
+        return out;
+    } };
+
+    bool ok{ true };
+    auto extract{ [&](auto& self, int i) -> Polynomial {
+        const Instruction& ins{ program.code[i] };
+        if ((ins.reads & varBit('y')) == 0) return { copy(copy, i) };
+        if (ins.isVariable) return { -1, add({ .value = 1 }) };
+
+        Polynomial left{ ins.left != -1 ? self(self, ins.left) : Polynomial{ -1 } };
+        Polynomial right{ ins.right != -1 ? self(self, ins.right) : Polynomial{ -1 } };
+        Polynomial out{ };
+        switch (ins.operation) {
+            case o::add:
+            case o::subtract:
+                out.assign(std::max(left.size(), right.size()), -1);
+                for (std::size_t k{ 0 }; k < out.size(); k++) {
+                    int a{ k < left.size() ? left[k] : -1 };
+                    int b{ k < right.size() ? right[k] : -1 };
+                    if (ins.operation == o::add) out[k] = sum(a, b);
+                    else if (b == -1) out[k] = a;
+                    else out[k] = a == -1 ? operation(o::negate, -1, b) : operation(o::subtract, a, b);
+                }
+                return out;
+            case o::negate:
+                for (const int c : right) out.push_back(c == -1 ? -1 : operation(o::negate, -1, c));
+                return out;
+            case o::multiply:
+                return product(left, right);
+            case o::divide:
+                if (right.size() > 1) break;
+                for (const int c : left) out.push_back(c == -1 ? -1 : operation(o::divide, c, right[0]));
+                return out;
+            case o::exponent: {
+                if (right.size() > 1 || ins.right == -1) break;
+                const Instruction& power{ program.code[ins.right] };
+                if (power.operation != o::none || power.isVariable || power.value < 0 || power.value > most
+                    || power.value != std::floor(power.value)) break;
+                out = { add({ .value = 1 }) };
+                for (int k{ 0 }; k < (int)power.value; k++) out = product(out, left);
+                return out;
+            }
+            default:
+                break;
+        }
+        ok = false;
+        return { -1 };
+    } };
+
+    Polynomial polynomial{ extract(extract, program.roots[0]) };
+    while (polynomial.size() > 1 && polynomial.back() == -1) polynomial.pop_back();
+    if (!ok || polynomial.size() < 2 || (int)polynomial.size() > most + 1) return false;
+    for (const int c : polynomial) coefficients.roots.push_back(c != -1 ? c : add({ }));
+    return true;
+}
+
+// Adds the real roots of c[0] + c[1]*y + ... + c[degree]*y^degree between low and high to out, in order.
+// Quadratics are solved directly, higher degrees by finding the roots of their derivative and then
+// halving each stretch between them that changes sign
+inline void polynomialRoots(const double* c, int degree, double low, double high, std::vector<double>& out) {
+    while (degree > 0 && c[degree] == 0) degree--;
+    auto keep{ [&](double root) {
+        if (root >= low && root <= high && (out.size() == 0 || root > out.back())) out.push_back(root);
+    } };
+    if (degree == 0) return;
+    if (degree == 1) {
+        keep(-c[0] / c[1]);
+        return;
+    }
+    if (degree == 2) {
+        double discriminant{ c[1]*c[1] - 4*c[2]*c[0] };
+        if (discriminant < 0) return;
+        // Without subtracting nearly equal numbers
+        double q{ -(c[1] + std::copysign(std::sqrt(discriminant), c[1])) / 2 };
+        double a{ q / c[2] };
+        double b{ q != 0 ? c[0] / q : a };
+        keep(std::min(a, b));
+        keep(std::max(a, b));
+        return;
+    }
+
+    std::array<double, 8> derivative{ };
+    for (int k{ 1 }; k <= degree; k++) derivative[k-1] = k * c[k];
+    std::vector<double> stops{ low };
+    polynomialRoots(derivative.data(), degree - 1, low, high, stops);
+    stops.push_back(high);
+    auto at{ [&](double y) {
+        double value{ 0 };
+        for (int k{ degree }; k >= 0; k--) value = value*y + c[k];
+        return value;
+    } };
+    for (std::size_t i{ 0 }; i+1 < stops.size(); i++) {
+        double a{ stops[i] };
+        double b{ stops[i+1] };
+        double valueA{ at(a) };
+        double valueB{ at(b) };
+        if (valueA == 0) keep(a);
+        if (!((valueA < 0 && valueB > 0) || (valueA > 0 && valueB < 0))) continue;
+        while (true) {
+            double middle{ (a + b) / 2 };
+            if (middle <= a || middle >= b) break;
+            double value{ at(middle) };
+            if ((value < 0) == (valueA < 0)) {
+                a = middle;
+                valueA = value;
+            } else {
+                b = middle;
+            }
+        }
+        keep(a);
+    }
+    if (at(high) == 0) keep(high);
+}
+
+// Solves an equation that's a polynomial in y (its coefficients, see polynomialInY) over a grid's
+// window, from the roots in every column at the column's middle and at its edges (halfway to the next
+// columns). The roots at the two edges are paired up in order and joined (through the middle's), so
+// steep parts are drawn unbroken. Where one edge has more roots, the closest of them are joined to each other (the curve
+// turns back between the edges, like a circle's sides). Out is a curve grid, like createCurve's.
+// Precision is only used for the coefficients (float precision solves them in double precision).
+inline Grid createRoots(const Program& coefficients, const Grid& settings, const std::atomic<bool>* cancel = nullptr) {
+    const int xSteps{ gridColumns(settings) };
+    Grid out{ settings };
+    out.engine = e::roots;
+    out.points = { };
+    out.points.resize(xSteps);
+    const int degree{ (int)coefficients.roots.size() - 1 };
+
+    // Middles, then edges
+    Batch batch{ .size = (std::size_t)(2*xSteps + 1), .precision = settings.precision == p::fast ? p::fast : p::exact };
+    std::vector<double>& xs{ batch.varying['x'] };
+    for (int x{ 0 }; x < xSteps; x++) xs.push_back(x*settings.stepX + settings.startX);
+    for (int x{ 0 }; x <= xSteps; x++) xs.push_back((x - 0.5)*settings.stepX + settings.startX);
+    Lanes lanes{ };
+    solveBatch(coefficients, batch, lanes);
+    out.solved = batch.size * coefficients.roots.size();
+    if (cancel != nullptr && *cancel) return out;
+
+    // Roots further off the window than its height don't matter
+    const double height{ settings.endY - settings.startY };
+    const double low{ settings.startY - height };
+    const double high{ settings.endY + height };
+    std::vector<std::vector<double>> roots(batch.size);
+    std::vector<bool> everywhere(batch.size, false); // every coefficient is 0, so every y is a root
+    for (std::size_t lane{ 0 }; lane < batch.size; lane++) {
+        std::array<double, 5> c{ };
+        bool zero{ true };
+        for (int k{ 0 }; k <= degree; k++) {
+            c[k] = laneValue(lanes, coefficients.roots[k], lane);
+            zero = zero && c[k] == 0;
+        }
+        everywhere[lane] = zero;
+        polynomialRoots(c.data(), degree, low, high, roots[lane]);
+    }
+
+    auto cover{ [&](int x, double y0, double y1) {
+        out.points[x].push_back(std::min(y0, y1));
+        out.points[x].push_back(std::max(y0, y1));
+    } };
+    // Joins the closest neighbouring roots until only keep are left. A root without a partner
+    // (it went off towards infinity, eg at an asymptote) is the one nearest to low or high
+    auto fold{ [&](int x, std::vector<double>& edge, std::size_t keep) {
+        if ((edge.size() - keep) % 2 == 1) {
+            bool first{ edge.front() - low < high - edge.back() };
+            double root{ first ? edge.front() : edge.back() };
+            cover(x, root, root);
+            edge.erase(first ? edge.begin() : edge.end() - 1);
+        }
+        while (edge.size() > keep) {
+            std::size_t closest{ 0 };
+            for (std::size_t i{ 1 }; i+1 < edge.size(); i++) {
+                if (edge[i+1] - edge[i] < edge[closest+1] - edge[closest]) closest = i;
+            }
+            cover(x, edge[closest], edge[closest+1]);
+            edge.erase(edge.begin() + closest, edge.begin() + closest + 2);
+        }
+    } };
+    for (int x{ 0 }; x < xSteps; x++) {
+        if (everywhere[x]) {
+            cover(x, settings.startY, settings.endY);
+            continue;
+        }
+        std::vector<double> left{ roots[xSteps + x] };
+        std::vector<double> right{ roots[xSteps + x + 1] };
+        const std::vector<double>& middle{ roots[x] };
+        std::size_t pairs{ std::min(left.size(), right.size()) };
+        fold(x, left, pairs);
+        fold(x, right, pairs);
+        for (std::size_t i{ 0 }; i < pairs; i++) {
+            double y0{ std::min(left[i], right[i]) };
+            double y1{ std::max(left[i], right[i]) };
+            // A root that crosses a pole (eg of TAN) jumps from one end to the other, and its middle isn't
+            // between them. Those aren't joined
+            if (middle.size() != pairs || middle[i] < y0 - settings.stepY || middle[i] > y1 + settings.stepY) {
+                cover(x, left[i], left[i]);
+                cover(x, right[i], right[i]);
+                continue;
+            }
+            cover(x, std::min(y0, middle[i]), std::max(y1, middle[i]));
+        }
+        if (middle.size() != pairs) {
+            for (const double root : middle) cover(x, root, root);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include "grid.hpp"
+
+// Where the time goes when a program is solved over a grid, per instruction (node of the compiled tree)
+struct InstructionProfile {
+    double seconds{ 0 };
+    std::size_t calls{ 0 }; // times it was solved: once per column, or once per grid if it doesn't read x
+    std::size_t values{ 0 }; // lanes solved over all calls
+    std::size_t nans{ 0 };
+    std::size_t infs{ 0 };
+};
+struct Profile {
+    std::vector<InstructionProfile> instructions{ };
+    double seconds{ 0 }; // time of one grid, all instructions
+    int runs{ 0 }; // grids solved to time it (times are per grid)
+    std::size_t points{ 0 };
+};
+
+// Solves a program over a grid the way createOverlay does (one batch over y per column, with
+// the parts that don't read x only solved for the first column), timing every instruction.
+// The grid is solved again until it's taken at least minimum seconds, and the times averaged.
+// Always solves in double precision (fast precision uses the fastmath.hpp kernels).
+inline Profile profileGrid(const Program& program, const Grid& settings, double minimum = 0.05) {
+    int xSteps{ gridColumns(settings) };
+    int ySteps{ gridRows(settings) };
+    Profile profile{ .instructions = std::vector<InstructionProfile>(program.code.size()), .points = (std::size_t)xSteps * ySteps };
+
+    Batch batch{ .size = (std::size_t)ySteps, .precision = settings.precision == p::fast ? p::fast : p::exact };
+    std::vector<double>& ys{ batch.varying['y'] };
+    for (int y{ 0 }; y < ySteps; y++) {
+        ys.push_back((y*settings.stepY) + settings.startY);
+    }
+    const unsigned int bits{ varyingBits(batch) };
+    Lanes lanes(program.code.size());
+
+    while (profile.runs == 0 || (profile.seconds < minimum && profile.runs < 1000)) {
+        bool counting{ profile.runs == 0 };
+        for (int x{ 0 }; x < xSteps; x++) {
+            batch.variables['x'-'a'] = (x*settings.stepX) + settings.startX;
+            for (std::size_t i{ 0 }; i < program.code.size(); i++) {
+                if (x > 0 && (program.code[i].reads & varBit('x')) == 0) continue;
+                auto start{ std::chrono::steady_clock::now() };
+                solveLanes(program, i, batch, bits, lanes);
+                double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+                InstructionProfile& instruction{ profile.instructions[i] };
+                instruction.seconds += seconds;
+                profile.seconds += seconds;
+                if (!counting) continue;
+                instruction.calls++;
+                instruction.values += lanes[i].size();
+                for (const double value : lanes[i]) {
+                    if (std::isnan(value)) instruction.nans++;
+                    else if (std::isinf(value)) instruction.infs++;
+                }
+            }
+        }
+        profile.runs++;
+    }
+    for (InstructionProfile& instruction : profile.instructions) instruction.seconds /= profile.runs;
+    profile.seconds /= profile.runs;
+    return profile;
+}
+
+// Nodes in a tree, to compare with the instructions it compiles to
+inline std::size_t countNodes(const TreeItem& item) {
+    return 1 + (item.left != nullptr ? countNodes(*item.left) : 0) + (item.right != nullptr ? countNodes(*item.right) : 0);
+}
+
+// How an instruction reads in an equation, eg SIN, *, x or 2.5
+inline std::string instructionLabel(const Instruction& ins) {
+    if (ins.isVariable) return std::string{ ins.variable };
+    switch (ins.operation) {
+        case o::none: {
+            std::ostringstream value{ };
+            value << ins.value;
+            return value.str();
+        }
+        case o::add: return "+";
+        case o::subtract: return "-";
+        case o::negate: return "-(negate)";
+        case o::multiply: return "*";
+        case o::divide: return "/";
+        case o::exponent: return "^";
+        case o::modulo: return "%";
+        case o::function: return fAsString(ins.function);
+        default: return oAsString(ins.operation);
+    }
+}
+
+// Prints the program as a tree from each root, every node with its share of the time on its own and with
+// everything under it, how many times it was solved and how many NaN/inf values it made.
+// Nodes used in more than one place (see compileTrees) are printed in full the first time only.
+inline void printProfile(const Program& program, const Profile& profile, std::ostream& out = std::cout) {
+    auto share{ [&](double seconds) {
+        std::ostringstream text{ };
+        text << std::fixed << std::setprecision(1) << std::setw(5) << (profile.seconds > 0 ? 100 * seconds / profile.seconds : 0) << "%";
+        return text.str();
+    } };
+    // Each instruction under i (once each, even if it's used twice)
+    auto subtree{ [&](int i) {
+        std::vector<bool> under(program.code.size(), false);
+        under[i] = true;
+        double seconds{ 0 };
+        for (int k{ i }; k >= 0; k--) {
+            if (!under[k]) continue;
+            seconds += profile.instructions[k].seconds;
+            if (program.code[k].left != -1) under[program.code[k].left] = true;
+            if (program.code[k].right != -1) under[program.code[k].right] = true;
+        }
+        return seconds;
+    } };
+
+    out << "Solved " << profile.points << " points in " << profile.seconds * 1000 << "ms"
+        << " (average of " << profile.runs << " runs), " << program.code.size() << " compiled nodes\n"
+        << " self subtree  node\n";
+    std::vector<bool> printed(program.code.size(), false);
+    auto print{ [&](auto& self, int i, int indentation, const std::string& pos) -> void {
+        const Instruction& ins{ program.code[i] };
+        const InstructionProfile& stats{ profile.instructions[i] };
+        out << share(stats.seconds) << " " << share(subtree(i)) << "  " << std::string(indentation*4, ' ')
+            << pos << " = " << instructionLabel(ins) << "  [#" << i << "]";
+        if (printed[i]) {
+            out << " (shared, see above)\n";
+            return;
+        }
+        printed[i] = true;
+        out << "  calls: " << stats.calls << "  values: " << stats.values;
+        if (stats.nans > 0) out << "  NaN: " << stats.nans;
+        if (stats.infs > 0) out << "  inf: " << stats.infs;
+        out << "\n";
+        if (ins.left != -1) self(self, ins.left, indentation + 1, "L");
+        if (ins.right != -1) self(self, ins.right, indentation + 1, "R");
+    } };
+    for (const int root : program.roots) print(print, root, 0, "0");
+}
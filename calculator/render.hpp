@@ -0,0 +1,209 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "library.hpp"
+
+// Solves and draws graphs in the background, so the prompt never waits for a graph.
+//
+// One thread solves grids and another draws them, with two grid buffers: while frame N
+// (the front buffer) is drawn, frame N+1 is solved into the back buffer, and they're swapped
+// once frame N has been drawn. Asking for a new frame cancels the one being solved, and a
+// solved frame is dropped if a newer one was asked for before it could be drawn.
+//
+// Grids are solved coarse-to-fine (see solveGridStride). A preview from the coarse points is
+// drawn once the next finer level wouldn't be done within the renderer's budget, then the
+// grid is refined and drawn again whenever the drawer is free, until every point is solved.
+
+// A graph to draw: the equation (or x(t) and y(t), for parametric curves), its window and a line to print above it
+struct Frame {
+    std::vector<TreeItem> trees{ };
+    Grid window{ };
+    std::string label{ };
+};
+
+struct Renderer {
+    std::mutex mutex{ };
+    std::condition_variable changed{ };
+    std::atomic<bool> cancel{ false }; // set to stop solving the current frame
+    std::atomic<double> budget{ 0.05 }; // seconds until the first preview, 0 to only draw finished grids
+    bool draw{ true }; // false to solve frames without printing them (set before startRenderer)
+
+    Frame pending{ };
+    bool hasPending{ false };
+    bool solving{ false };
+    bool stopping{ false };
+
+    Grid back{ };
+    Grid front{ };
+    std::string frontLabel{ };
+    bool frontFull{ false }; // front is waiting to be (or being) drawn
+
+    std::size_t drawn{ 0 };
+    std::size_t dropped{ 0 }; // cancelled, or solved after a newer frame was asked for
+    std::thread solver{ };
+    std::thread drawer{ };
+};
+
+// Draws a graph. For float precision it says how many points needed double precision,
+// and for functions, curves and traced or root-solved equations how many values were solved
+inline void showGrid(const Grid& grid, std::ostream& out = std::cout) {
+    if (grid.mode != m::equation || grid.engine != e::grid) {
+        drawCurve(grid, out);
+        out << "(I) Solved " << grid.solved << " values for " << gridColumns(grid) << " columns\n";
+        return;
+    }
+    drawGrid(grid, false, out);
+    if (grid.precision == p::single) {
+        out << "(I) " << grid.refined << " of " << gridColumns(grid)*gridRows(grid)
+            << " points were solved again in double precision\n";
+    }
+}
+
+// Hands grid to the drawer (swapping it with the front buffer). If wait is false and the drawer is
+// busy, nothing happens. Returns false if a newer frame was asked for. lock must hold renderer.mutex
+inline bool presentFrame(Renderer& renderer, std::unique_lock<std::mutex>& lock, Grid& grid, const std::string& label, bool wait) {
+    if (wait) renderer.changed.wait(lock, [&] { return !renderer.frontFull || renderer.hasPending; });
+    if (renderer.hasPending) return false;
+    if (renderer.frontFull) return true;
+    std::swap(renderer.front, grid);
+    renderer.frontLabel = label;
+    renderer.frontFull = true;
+    renderer.changed.notify_all();
+    return true;
+}
+
+// Solves a frame coarse-to-fine into renderer.back, drawing previews along the way.
+// Returns false if cancelled, or (with error) if the window can't be solved
+inline bool solveProgressive(Renderer& renderer, const Program& program, const Frame& frame, std::string& error) {
+    if (!checkWindow(frame.window, error)) return false;
+    int xSteps{ gridColumns(frame.window) };
+    int ySteps{ gridRows(frame.window) };
+    Grid& grid{ renderer.back };
+    try {
+        grid = frame.window;
+        grid.engine = e::grid;
+        grid.points = { };
+        grid.signs = makeSigns(xSteps, ySteps); // only drawn, so only the signs are kept
+    } catch (const std::bad_alloc&) {
+        error = "Grid is too large";
+        return false;
+    }
+    auto levelPoints{ [&](int stride) {
+        return (double)((xSteps + stride-1)/stride) * ((ySteps + stride-1)/stride);
+    } };
+    auto start{ std::chrono::steady_clock::now() };
+
+    // Start from about a thousand points, to measure how fast this equation solves
+    int stride{ 1 };
+    while (levelPoints(stride) > 1024) stride *= 2;
+    solveGridStride(program, grid, stride, false, &renderer.cancel);
+    double solved{ levelPoints(stride) };
+
+    bool previewed{ false };
+    while (stride > 1 && !renderer.cancel) {
+        double elapsed{ std::max(1e-6, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()) };
+        double next{ levelPoints(stride/2) - levelPoints(stride) };
+        if (previewed || elapsed + next / (solved / elapsed) > renderer.budget) {
+            Grid preview{ fillGrid(grid, stride) };
+            std::string label{ frame.label + (frame.label.size() > 0 ? "\n" : "") + "(I) Preview from 1 in "
+                + std::to_string(stride*stride) + " points, refining..." };
+            std::unique_lock lock{ renderer.mutex };
+            if (!presentFrame(renderer, lock, preview, label, !previewed)) return false;
+            previewed = true;
+        }
+        stride /= 2;
+        solveGridStride(program, grid, stride, true, &renderer.cancel);
+        solved += next;
+    }
+    return !renderer.cancel;
+}
+
+inline void solveFrames(Renderer& renderer) {
+    std::unique_lock lock{ renderer.mutex };
+    while (true) {
+        renderer.changed.wait(lock, [&] { return renderer.hasPending || renderer.stopping; });
+        if (!renderer.hasPending) return;
+        Frame frame{ std::move(renderer.pending) };
+        renderer.hasPending = false;
+        renderer.solving = true;
+        renderer.cancel = false;
+        lock.unlock();
+
+        Program program{ };
+        std::string error{ };
+        compileEquations(frame.trees, program, error); // Unknown functions were already warned about
+        // Float grids need every point to decide which to solve again, so they're solved in one go.
+        // Functions, curves and traced or root-solved equations only solve a few points per column, so they don't need previews
+        Program coefficients{ };
+        bool ok{ frame.window.precision == p::single || frame.window.mode != m::equation || frame.window.engine == e::trace
+            || (frame.window.engine == e::roots && polynomialInY(program, coefficients)) || renderer.budget <= 0
+            ? solveGrid(program, frame.window, renderer.back, error, &renderer.cancel, true)
+            : solveProgressive(renderer, program, frame, error) };
+
+        lock.lock();
+        if (!ok && !renderer.cancel) {
+            std::cout << "<!> [solveFrames:0] " + error + "\n" << std::flush;
+        }
+        if (!ok || !presentFrame(renderer, lock, renderer.back, frame.label, true)) {
+            if (renderer.cancel) renderer.dropped++;
+        }
+        renderer.solving = false;
+        renderer.changed.notify_all();
+    }
+}
+
+inline void drawFrames(Renderer& renderer) {
+    std::unique_lock lock{ renderer.mutex };
+    while (true) {
+        renderer.changed.wait(lock, [&] { return renderer.frontFull || (renderer.stopping && !renderer.solving && !renderer.hasPending); });
+        if (!renderer.frontFull) return;
+        // The solver doesn't touch front while it's full
+        lock.unlock();
+        if (renderer.draw) {
+            std::ostringstream text{ };
+            if (renderer.frontLabel.size() > 0) text << renderer.frontLabel << "\n";
+            showGrid(renderer.front, text);
+            std::cout << text.str() << std::flush; // in one piece, so it isn't mixed with the prompt
+        }
+        lock.lock();
+        renderer.frontFull = false;
+        renderer.drawn++;
+        renderer.changed.notify_all();
+    }
+}
+
+inline void startRenderer(Renderer& renderer) {
+    renderer.solver = std::thread{ solveFrames, std::ref(renderer) };
+    renderer.drawer = std::thread{ drawFrames, std::ref(renderer) };
+}
+
+// Asks for a graph to be drawn, cancelling any that haven't been drawn yet
+inline void requestFrame(Renderer& renderer, Frame frame) {
+    std::lock_guard lock{ renderer.mutex };
+    if (renderer.hasPending) renderer.dropped++;
+    renderer.pending = std::move(frame);
+    renderer.hasPending = true;
+    renderer.cancel = true;
+    renderer.changed.notify_all();
+}
+
+// Waits until every frame asked for has been drawn (or dropped)
+inline void finishFrames(Renderer& renderer) {
+    std::unique_lock lock{ renderer.mutex };
+    renderer.changed.wait(lock, [&] { return !renderer.hasPending && !renderer.solving && !renderer.frontFull; });
+}
+
+// Draws the last frame asked for, then stops the threads
+inline void stopRenderer(Renderer& renderer) {
+    {
+        std::lock_guard lock{ renderer.mutex };
+        renderer.stopping = true;
+        renderer.changed.notify_all();
+    }
+    if (renderer.solver.joinable()) renderer.solver.join();
+    if (renderer.drawer.joinable()) renderer.drawer.join();
+}
@@ -0,0 +1,479 @@
+#pragma once
+#ifdef _WIN32
+#error "The evaluation server uses Unix domain sockets"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "library.hpp"
+#include "store.hpp"
+
+// Evaluation server, so other programs can solve equations without starting the calculator
+// (and parsing) for every query. Run with `new --serve [socket path]`.
+//
+// Every message is a frame: u32 payload length, then the payload (native byte order).
+// Requests:
+//   u8 kind (see q)
+//   points: u32 equation length, equation, u32 lanes, u8 variable count,
+//           then per variable: char variable, f64 value per lane
+//   grid:   u32 equation length, equation, f64 startX, startY, endX, endY, stepX, stepY, u8 precision
+//   stats, stop: nothing else
+// Responses:
+//   u8 0, u32 columns, u32 rows, f64 values (column by column)
+//     points: one column per lane, 1 row
+//     grid:   Grid::points
+//     stats:  5 columns, 1 row: request count, then p50, p90, p99 and max latency in microseconds
+//   u8 1, error message (the rest of the frame)
+//
+// Point requests for the same equation that arrive while it's being solved are solved together
+// as one batch, and grid requests for the same equation and window share one grid.
+// Compiled equations are kept between requests.
+enum class q : std::uint8_t {
+    points = 1,
+    grid,
+    stats,
+    stop
+};
+
+struct Request {
+    q kind{ q::points };
+    std::string equation{ };
+    Batch batch{ }; // points
+    Grid window{ }; // grid
+};
+
+struct Response {
+    bool ok{ true };
+    std::string error{ };
+    std::uint32_t columns{ 0 };
+    std::uint32_t rows{ 0 };
+    std::vector<double> values{ };
+};
+
+// Largest frame either side will read
+const std::uint32_t maxFrame{ 64u << 20 };
+
+inline bool readAll(int fd, char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t got{ ::read(fd, data, size) };
+        if (got <= 0) return false;
+        data += got;
+        size -= got;
+    }
+    return true;
+}
+inline bool writeAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t sent{ ::send(fd, data, size, MSG_NOSIGNAL) };
+        if (sent <= 0) return false;
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Reads one frame's payload. Returns false if the connection closed or the frame is too large
+inline bool readFrame(int fd, std::string& payload) {
+    std::uint32_t size{ };
+    if (!readAll(fd, (char*)&size, sizeof(size)) || size > maxFrame) return false;
+    payload.resize(size);
+    return readAll(fd, payload.data(), size);
+}
+inline bool writeFrame(int fd, const std::string& payload) {
+    std::string frame{ };
+    writeValue<std::uint32_t>(frame, payload.size());
+    frame += payload;
+    return writeAll(fd, frame.data(), frame.size());
+}
+
+inline std::string writeRequest(const Request& request) {
+    std::string out{ };
+    writeValue<std::uint8_t>(out, (std::uint8_t)request.kind);
+    if (request.kind != q::points && request.kind != q::grid) return out;
+    writeValue<std::uint32_t>(out, request.equation.size());
+    out += request.equation;
+    if (request.kind == q::points) {
+        writeValue<std::uint32_t>(out, request.batch.size);
+        writeValue<std::uint8_t>(out, request.batch.varying.size());
+        for (const auto& [variable, values] : request.batch.varying) {
+            writeValue<char>(out, variable);
+            for (const double value : values) writeValue<double>(out, value);
+        }
+    } else {
+        const Grid& window{ request.window };
+        for (const double value : { window.startX, window.startY, window.endX, window.endY, window.stepX, window.stepY }) {
+            writeValue<double>(out, value);
+        }
+        writeValue<std::uint8_t>(out, (std::uint8_t)window.precision);
+    }
+    return out;
+}
+
+// Returns false and sets error if the request isn't valid
+inline bool readRequest(const std::string& payload, Request& request, std::string& error) {
+    StoreReader reader{ payload.data(), payload.size() };
+    std::uint8_t kind{ reader.read<std::uint8_t>() };
+    if (!reader.ok || kind < (std::uint8_t)q::points || kind > (std::uint8_t)q::stop) {
+        error = "Unknown request kind";
+        return false;
+    }
+    request = { };
+    request.kind = (q)kind;
+    if (request.kind == q::points || request.kind == q::grid) {
+        std::uint32_t length{ reader.read<std::uint32_t>() };
+        const char* equation{ reader.skip(length) };
+        if (equation != nullptr) request.equation.assign(equation, length);
+    }
+    if (request.kind == q::points) {
+        Batch& batch{ request.batch };
+        batch.size = reader.read<std::uint32_t>();
+        std::uint8_t count{ reader.read<std::uint8_t>() };
+        if (batch.size > reader.size / sizeof(double) + 1) {
+            error = "Request has more lanes than values";
+            return false;
+        }
+        for (std::uint8_t i{ 0 }; i < count && reader.ok; i++) {
+            char variable{ reader.read<char>() };
+            if (variable < 'a' || variable > 'z') {
+                error = "Variables must be a-z";
+                return false;
+            }
+            std::vector<double>& values{ batch.varying[variable] };
+            values.resize(batch.size);
+            for (double& value : values) value = reader.read<double>();
+        }
+    } else if (request.kind == q::grid) {
+        Grid& window{ request.window };
+        for (double* value : { &window.startX, &window.startY, &window.endX, &window.endY, &window.stepX, &window.stepY }) {
+            *value = reader.read<double>();
+        }
+        std::uint8_t precision{ reader.read<std::uint8_t>() };
+        if (precision > (std::uint8_t)p::single) {
+            error = "Unknown precision";
+            return false;
+        }
+        window.precision = (p)precision;
+        // The response has to fit in a frame
+        double points{ ((window.endX - window.startX)/window.stepX + 1) * ((window.endY - window.startY)/window.stepY + 1) };
+        if (window.stepX > 0 && window.stepY > 0 && !(points * sizeof(double) < maxFrame - 64)) {
+            error = "Grid is too large";
+            return false;
+        }
+    }
+    if (!reader.ok || reader.pos != reader.size) {
+        error = "Request is the wrong length";
+        return false;
+    }
+    return true;
+}
+
+inline std::string writeResponse(const Response& response) {
+    std::string out{ };
+    writeValue<std::uint8_t>(out, response.ok ? 0 : 1);
+    if (!response.ok) return out + response.error;
+    writeValue<std::uint32_t>(out, response.columns);
+    writeValue<std::uint32_t>(out, response.rows);
+    for (const double value : response.values) writeValue<double>(out, value);
+    return out;
+}
+
+inline bool readResponse(const std::string& payload, Response& response) {
+    StoreReader reader{ payload.data(), payload.size() };
+    response = { };
+    response.ok = reader.read<std::uint8_t>() == 0;
+    if (!reader.ok) return false;
+    if (!response.ok) {
+        response.error = payload.substr(1);
+        return true;
+    }
+    response.columns = reader.read<std::uint32_t>();
+    response.rows = reader.read<std::uint32_t>();
+    if ((std::uint64_t)response.columns * response.rows != (reader.size - reader.pos) / sizeof(double)) return false;
+    response.values.resize((std::size_t)response.columns * response.rows);
+    for (double& value : response.values) value = reader.read<double>();
+    return reader.ok && reader.pos == reader.size;
+}
+
+// The value at percentile (0-100) of some values, eg 50 for the median. 0 if there are none
+inline double percentile(std::vector<double> values, double at) {
+    if (values.size() == 0) return 0;
+    std::size_t rank{ (std::size_t)std::min<double>(values.size() - 1, at / 100 * values.size()) };
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+// Requests waiting to be solved together (same equation, or same equation and window).
+// The first one to arrive solves everyone's, including any that arrive while it's solving.
+struct Waiting {
+    Request* request{ nullptr };
+    Response* response{ nullptr };
+    bool done{ false };
+};
+struct Coalesced {
+    std::vector<Waiting*> waiting{ };
+    bool solving{ false };
+};
+
+struct Server {
+    std::string path{ };
+    int listener{ -1 };
+    std::atomic<bool> stopping{ false };
+
+    // Compiled equations, by text. Cleared when it gets too large
+    std::mutex cacheMutex{ };
+    std::unordered_map<std::string, std::shared_ptr<const Program>> cache{ };
+    std::size_t cacheLimit{ 4096 };
+
+    std::atomic<std::size_t> batches{ 0 }; // solves, each for one or more requests
+    std::mutex coalesceMutex{ };
+    std::condition_variable solved{ };
+    std::unordered_map<std::string, Coalesced> coalesced{ };
+
+    // Latency of recent requests in microseconds (the last latencyLimit)
+    std::mutex statsMutex{ };
+    std::vector<double> latencies{ };
+    std::size_t latencyCount{ 0 };
+    std::size_t latencyLimit{ 1 << 20 };
+
+    std::mutex connectionMutex{ };
+    std::condition_variable closed{ };
+    std::set<int> connections{ };
+};
+
+// The compiled equation, from the cache if it's been compiled before
+inline std::shared_ptr<const Program> serverProgram(Server& server, const std::string& equation, std::string& error) {
+    {
+        std::lock_guard lock{ server.cacheMutex };
+        auto found{ server.cache.find(equation) };
+        if (found != server.cache.end()) return found->second;
+    }
+    TreeItem tree{ };
+    auto program{ std::make_shared<Program>() };
+    if (!parseEquation(equation, tree, error) || !compileEquation(tree, *program, error)) return nullptr;
+
+    std::lock_guard lock{ server.cacheMutex };
+    if (server.cache.size() >= server.cacheLimit) server.cache.clear();
+    server.cache.emplace(equation, program);
+    return program;
+}
+
+// Solves every point request in the group as one batch. Variables a request doesn't give are 0.
+inline void solvePointGroup(const Program& program, const std::vector<Waiting*>& group) {
+    Batch batch{ .size = 0 };
+    for (const Waiting* waiting : group) {
+        for (const auto& [variable, values] : waiting->request->batch.varying) batch.varying[variable];
+    }
+    for (const Waiting* waiting : group) {
+        const Batch& own{ waiting->request->batch };
+        for (auto& [variable, values] : batch.varying) {
+            auto found{ own.varying.find(variable) };
+            if (found != own.varying.end()) values.insert(values.end(), found->second.begin(), found->second.end());
+            else values.resize(values.size() + own.size, 0);
+        }
+        batch.size += own.size;
+    }
+
+    std::vector<double> values{ };
+    std::string error{ };
+    bool ok{ solvePoints(program, batch, values, error) };
+    std::size_t first{ 0 };
+    for (Waiting* waiting : group) {
+        Response& response{ *waiting->response };
+        std::size_t size{ waiting->request->batch.size };
+        response.ok = ok;
+        response.error = error;
+        if (ok) {
+            response.columns = size;
+            response.rows = 1;
+            response.values.assign(values.begin() + first, values.begin() + first + size);
+        }
+        first += size;
+    }
+}
+
+// Responses are the equation's value at every point, so the window is always solved with e::grid
+inline void solveGridGroup(const Program& program, const std::vector<Waiting*>& group) {
+    Grid window{ group.at(0)->request->window };
+    window.mode = m::equation;
+    window.engine = e::grid;
+    Grid grid{ };
+    std::string error{ };
+    bool ok{ solveGrid(program, window, grid, error) };
+    for (Waiting* waiting : group) {
+        Response& response{ *waiting->response };
+        response.ok = ok;
+        response.error = error;
+        if (!ok) continue;
+        response.columns = grid.points.size();
+        response.rows = grid.points.size() > 0 ? grid.points[0].size() : 0;
+        response.values.clear();
+        response.values.reserve((std::size_t)response.columns * response.rows);
+        for (const std::vector<double>& column : grid.points) {
+            response.values.insert(response.values.end(), column.begin(), column.end());
+        }
+    }
+}
+
+// Solves a points or grid request, together with any others waiting on the same equation (and window)
+inline void solveRequest(Server& server, Request& request, Response& response) {
+    std::string key{ request.equation };
+    if (request.kind == q::grid) {
+        key = writeRequest(request); // includes the window
+    } else if (request.batch.size == 0) {
+        response = { .ok = true };
+        return;
+    }
+    std::string error{ };
+    std::shared_ptr<const Program> program{ serverProgram(server, request.equation, error) };
+    if (program == nullptr) {
+        response = { .ok = false, .error = error };
+        return;
+    }
+
+    Waiting own{ &request, &response };
+    std::unique_lock lock{ server.coalesceMutex };
+    Coalesced& group{ server.coalesced[key] };
+    group.waiting.push_back(&own);
+    // While someone else is solving this equation, wait for them to finish. Their batch was taken
+    // before this request arrived, so after that, one of the requests waiting (maybe this one) solves
+    // all of them as the next batch. The group isn't erased while anyone's waiting in it
+    server.solved.wait(lock, [&] { return own.done || !group.solving; });
+    if (own.done) return;
+
+    group.solving = true;
+    std::vector<Waiting*> taken{ };
+    taken.swap(group.waiting);
+    lock.unlock();
+    server.batches++;
+    if (request.kind == q::grid) solveGridGroup(*program, taken);
+    else solvePointGroup(*program, taken);
+    lock.lock();
+    for (Waiting* waiting : taken) waiting->done = true;
+    // Requests that arrived meanwhile are handed to one of their own threads, so this one can
+    // respond now instead of solving for others under steady load
+    if (group.waiting.size() > 0) group.solving = false;
+    else server.coalesced.erase(key);
+    server.solved.notify_all();
+}
+
+inline void recordLatency(Server& server, double microseconds) {
+    std::lock_guard lock{ server.statsMutex };
+    if (server.latencies.size() < server.latencyLimit) server.latencies.push_back(microseconds);
+    else server.latencies[server.latencyCount % server.latencyLimit] = microseconds;
+    server.latencyCount++;
+}
+
+// Request count, then p50, p90, p99 and max latency (microseconds)
+inline std::vector<double> latencyStats(Server& server) {
+    std::vector<double> latencies{ };
+    std::size_t count{ 0 };
+    {
+        std::lock_guard lock{ server.statsMutex };
+        latencies = server.latencies;
+        count = server.latencyCount;
+    }
+    return { (double)count, percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99), percentile(latencies, 100) };
+}
+
+inline void serveConnection(Server& server, int fd) {
+    std::string payload{ };
+    while (!server.stopping && readFrame(fd, payload)) {
+        auto start{ std::chrono::steady_clock::now() };
+        Request request{ };
+        Response response{ };
+        std::string error{ };
+        if (!readRequest(payload, request, error)) {
+            response = { .ok = false, .error = error };
+        } else if (request.kind == q::stats) {
+            response.values = latencyStats(server);
+            response.columns = response.values.size();
+            response.rows = 1;
+        } else if (request.kind == q::stop) {
+            server.stopping = true;
+        } else {
+            solveRequest(server, request, response);
+        }
+        if (!writeFrame(fd, writeResponse(response))) break;
+        if (request.kind == q::points || request.kind == q::grid) {
+            recordLatency(server, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    // Closed under the lock, so serve() can't accept a connection that reuses the fd (and have its
+    // entry erased here) or shut it down before it's erased
+    std::lock_guard lock{ server.connectionMutex };
+    server.connections.erase(fd);
+    ::close(fd);
+    server.closed.notify_all();
+}
+
+// Listens on the server's path until a stop request. Returns false and sets error if it can't listen
+inline bool serve(Server& server, std::string& error) {
+    sockaddr_un address{ };
+    address.sun_family = AF_UNIX;
+    if (server.path.size() >= sizeof(address.sun_path)) {
+        error = "Socket path is too long";
+        return false;
+    }
+    std::copy(server.path.begin(), server.path.end(), address.sun_path);
+
+    server.listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(server.path.c_str()); // left over from a server that didn't stop cleanly
+    if (server.listener < 0 || ::bind(server.listener, (sockaddr*)&address, sizeof(address)) != 0
+        || ::listen(server.listener, 64) != 0)
+    {
+        error = "Could not listen on " + server.path;
+        if (server.listener >= 0) ::close(server.listener);
+        return false;
+    }
+
+    while (!server.stopping) {
+        // Wake up now and then to see if a connection asked to stop
+        pollfd ready{ server.listener, POLLIN, 0 };
+        if (::poll(&ready, 1, 100) <= 0) continue;
+        int fd{ ::accept(server.listener, nullptr, nullptr) };
+        if (fd < 0) continue;
+        {
+            std::lock_guard lock{ server.connectionMutex };
+            server.connections.insert(fd);
+        }
+        std::thread{ serveConnection, std::ref(server), fd }.detach();
+    }
+
+    ::close(server.listener);
+    ::unlink(server.path.c_str());
+    // Wake up connections waiting for their next request, and wait for them to finish
+    std::unique_lock lock{ server.connectionMutex };
+    for (const int fd : server.connections) ::shutdown(fd, SHUT_RDWR);
+    server.closed.wait(lock, [&] { return server.connections.size() == 0; });
+    return true;
+}
+
+// Client side: connects to a server. Returns -1 if it can't
+inline int connectServer(const std::string& path) {
+    sockaddr_un address{ };
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return -1;
+    std::copy(path.begin(), path.end(), address.sun_path);
+    int fd{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+    if (fd >= 0 && ::connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Client side: sends a request and waits for the response. Returns false if the connection failed
+inline bool askServer(int fd, const Request& request, Response& response) {
+    std::string payload{ };
+    return writeFrame(fd, writeRequest(request)) && readFrame(fd, payload) && readResponse(payload, response);
+}
@@ -1,44 +1,57 @@
 #pragma once
+#include <cmath>
+#include <map>
+#ifndef SNUMBERS
+#include <numbers>
+#else
+// Older g++ doesn't have <numbers>
+namespace std::numbers {
+    inline constexpr double pi{ 3.1415926535 };
+    inline constexpr double e{ 2.7182818284 };
+}
+#endif
 #include "tree.hpp"
 
-double doFunction(std::string name, double leftValue = 0, double value = 0) {
-    // Trigonometry
-    if      (name == "SIN")   return std::sin(value);
-    else if (name == "ASIN")  return std::asin(value);
-    else if (name == "COS")   return std::cos(value);
-    else if (name == "ACOS")  return std::acos(value);
-    else if (name == "TAN")   return std::tan(value);
-    else if (name == "ATAN")  return std::atan(value);
-    // Roots
-    // No NTHROOT function because you can do that with x^(1/y)
-    else if (name == "SQRT")  return std::sqrt(value);
-    else if (name == "CBRT")  return std::pow(value, (1/3));
-    // Logarithms
-    // No LOGBASE function because you can do that with change-of-base
-    else if (name == "LOG")   return std::log10(value);
-    else if (name == "LB")    return std::log2(value);
-    else if (name == "LN")    return std::log(value);
-    // Etc
-    else if (name == "ABS" && value >= 0)  return value;
-    else if (name == "ABS" && value < 0)   return -value;
-    else if (name == "SIGN" && value > 0)  return 1;
-    else if (name == "SIGN" && value == 0) return 0;
-    else if (name == "SIGN" && value < 0)  return -1;
-    // Modulo
-    // NOTE / TODO - Remove setter functions
-    else if (name == "EVEN")  return std::fmod(value, 2);
-    // Math constants
-    else if (name == "PI" && value != 0)  return std::numbers::pi * value;
-    else if (name == "PI")    return std::numbers::pi;
-    else if (name == "E" && value != 0)  return std::numbers::e * value;
-    else if (name == "E")     return std::numbers::e;
-    else {
+constexpr double doFunction(f name, double leftValue = 0, double value = 0) {
+    switch(name) {
+        // Trigonometry
+        case f::sin:  return std::sin(value);
+        case f::asin: return std::asin(value);
+        case f::cos:  return std::cos(value);
+        case f::acos: return std::acos(value);
+        case f::tan:  return std::tan(value);
+        case f::atan: return std::atan(value);
+        // Roots
+        // No NTHROOT function because you can do that with x^(1/y)
+        case f::sqrt: return std::sqrt(value);
+        case f::cbrt: return std::cbrt(value);
+        // Logarithms
+        // No LOGBASE function because you can do that with change-of-base
+        case f::log:  return std::log10(value);
+        case f::lb:   return std::log2(value);
+        case f::ln:   return std::log(value);
+        // Etc
+        case f::abs:  return value >= 0 ? value : -value;
+        case f::sign: return value > 0 ? 1 : (value == 0 ? 0 : -1);
+        // Modulo
+        case f::even: return std::fmod(value, 2);
+        // Math constants
+        case f::pi:   return value != 0 ? std::numbers::pi * value : std::numbers::pi;
+        case f::e:    return value != 0 ? std::numbers::e * value : std::numbers::e;
+        case f::none:
+        default: return 0;
+    }
+}
+inline double doFunction(std::string name, double leftValue = 0, double value = 0) {
+    f function{ fFromString(name) };
+    if (function == f::none) {
         std::cout << "<?> Unknown function " << name << "\n";
         return 0;
     }
+    return doFunction(function, leftValue, value);
 }
 
-double solveOperation(o oper, double left, double right, std::string function = "") {
+inline double solveOperation(o oper, double left, double right, std::string function = "") {
     switch(oper) {
         case o::add: return left + right;
         case o::subtract: return left - right;
@@ -53,7 +66,7 @@ double solveOperation(o oper, double left, double right, std::string function =
     }
 }
 
-double solveTree(const TreeItem& item, std::map<char, double> variables) {
+inline double solveTree(const TreeItem& item, std::map<char, double> variables) {
     double left{ 0 };
     double right{ 0 };
     // {0, 1} so right happens first and
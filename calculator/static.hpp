@@ -0,0 +1,387 @@
+#pragma once
+#include <concepts>
+#include <string_view>
+#include "grid.hpp"
+
+// Equations parsed at compile time, for equations that are known when the program is built.
+//
+//     using Circle = StaticTree<"x^2 + y^2 - 25">;
+//     double value{ Circle::solve(3, 4) };
+//     Grid grid{ createGrid(Circle{ }, settings) };
+//
+// The equation is tokenized, cleaned and built with the same rules as tokenize, clean and
+// buildTree, into a type the compiler can inline completely. Mistakes in the equation are
+// compile errors. Unknown functions are errors too, instead of solving as 0.
+
+// A string literal usable as a template argument
+template <std::size_t N>
+struct Literal {
+    char text[N]{ };
+    constexpr Literal(const char (&literal)[N]) {
+        for (std::size_t i{ 0 }; i < N; i++) text[i] = literal[i];
+    }
+};
+
+// Same names as fAsString
+constexpr std::pair<std::string_view, f> staticFunctionNames[]{
+    { "SIN", f::sin }, { "ASIN", f::asin }, { "COS", f::cos }, { "ACOS", f::acos },
+    { "TAN", f::tan }, { "ATAN", f::atan }, { "SQRT", f::sqrt }, { "CBRT", f::cbrt },
+    { "LOG", f::log }, { "LB", f::lb }, { "LN", f::ln }, { "ABS", f::abs },
+    { "SIGN", f::sign }, { "EVEN", f::even }, { "PI", f::pi }, { "E", f::e }
+};
+
+// A token, like Token, except groups are a range of the equation's text
+// that is tokenized when the group is built
+struct StaticToken {
+    t type{ t::none };
+    o operation{ o::none };
+    f function{ f::none };
+    double number{ 0 };
+    char variable{ '&' };
+    std::size_t begin{ 0 };
+    std::size_t end{ 0 };
+};
+
+template <std::size_t N>
+struct StaticTokens {
+    // Cleaning can add a multiply between every pair of tokens
+    StaticToken tokens[2*N + 2]{ };
+    std::size_t size{ 0 };
+
+    constexpr void insert(std::size_t at, StaticToken token) {
+        if (size >= 2*N + 2) throw "Too many tokens";
+        for (std::size_t i{ size }; i > at; i--) tokens[i] = tokens[i-1];
+        tokens[at] = token;
+        size++;
+    }
+    constexpr void erase(std::size_t at) {
+        for (std::size_t i{ at }; i+1 < size; i++) tokens[i] = tokens[i+1];
+        size--;
+    }
+};
+
+// The built tree, as instructions (without CSE) so it can be turned into types
+template <std::size_t N>
+struct StaticPool {
+    Instruction code[2*N + 2]{ };
+    int size{ 0 };
+    int root{ -1 };
+
+    constexpr int add(Instruction ins) {
+        if (size >= (int)(2*N + 2)) throw "Too many tree items";
+        code[size] = ins;
+        return size++;
+    }
+};
+
+constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// tokenize, for text.at(begin) up to text.at(end)
+template <std::size_t N>
+constexpr StaticTokens<N> staticTokenize(const Literal<N>& equation, std::size_t begin, std::size_t end) {
+    StaticTokens<N> out{ };
+    const char* text{ equation.text };
+    std::size_t pos{ begin };
+    while (pos < end) {
+        char c{ text[pos] };
+        StaticToken token{ };
+        if (isDigit(c) || (c == '.' && pos+1 < end && isDigit(text[pos+1]))) {
+            // \d+(\.\d+)? or \.\d+, as digits / 10^fraction digits
+            token.type = t::number;
+            double digits{ 0 };
+            double scale{ 1 };
+            while (pos < end && isDigit(text[pos])) digits = digits*10 + (text[pos++] - '0');
+            if (pos+1 < end && text[pos] == '.' && isDigit(text[pos+1])) {
+                pos++;
+                while (pos < end && isDigit(text[pos])) {
+                    digits = digits*10 + (text[pos++] - '0');
+                    scale *= 10;
+                }
+            }
+            token.number = digits / scale;
+
+        } else if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^' || c == '%') {
+            token.type = t::operation;
+            switch (c) {
+                case '+': token.operation = o::add;      break;
+                case '-': token.operation = o::subtract; break;
+                case '*': token.operation = o::multiply; break;
+                case '/': token.operation = o::divide;   break;
+                case '^': token.operation = o::exponent; break;
+                case '%': token.operation = o::modulo;   break;
+            }
+            pos++;
+
+        } else if (c >= 'a' && c <= 'z') {
+            token.type = t::variable;
+            token.variable = c;
+            pos++;
+
+        } else if (c >= 'A' && c <= 'Z') {
+            std::size_t start{ pos };
+            while (pos < end && text[pos] >= 'A' && text[pos] <= 'Z') pos++;
+            std::string_view name{ text + start, pos - start };
+            token.type = t::operation;
+            token.operation = o::function;
+            for (const auto& [functionName, function] : staticFunctionNames) {
+                if (functionName == name) token.function = function;
+            }
+            if (token.function == f::none) throw "Unknown function";
+
+        } else if (c == '(') {
+            std::size_t close{ pos + 1 };
+            std::size_t depth{ 0 };
+            while (close < end) {
+                if (text[close] == ')') {
+                    if (depth == 0) break;
+                    else depth -= 1;
+                } else if (text[close] == '(') {
+                    depth += 1;
+                }
+                close++;
+            }
+            if (close >= end) throw "Unmatched parentheses";
+            token.type = t::group;
+            token.begin = pos + 1;
+            token.end = close;
+            pos = close + 1;
+
+        } else if (c == ' ') {
+            pos++;
+            continue;
+        } else {
+            throw "Cannot parse part of equation";
+        }
+        out.insert(out.size, token);
+    }
+    return out;
+}
+
+// clean, except groups are cleaned when they're built
+template <std::size_t N>
+constexpr void staticClean(StaticTokens<N>& list) {
+    if (list.size < 1) {
+        // Zero-length equation or group, implicit 0
+        StaticToken zero{ t::number };
+        list.insert(0, zero);
+        return;
+    }
+    if (list.tokens[0].operation == o::subtract) {
+        list.tokens[0].operation = o::negate;
+    }
+    if (list.tokens[list.size-1].type == t::operation) throw "Equation contains a trailing operator";
+
+    for (std::size_t i{ 1 }; i < list.size; i++) {
+        StaticToken* tk{ list.tokens };
+        if ((tk[i].type != t::operation || tk[i].operation == o::function) && tk[i-1].type != t::operation) {
+            StaticToken multiply{ t::operation };
+            multiply.operation = o::multiply;
+            list.insert(i, multiply);
+        }
+        if (i >= list.size-1) break;
+
+        if (tk[i].type == t::operation && tk[i-1].type == t::operation && tk[i+1].type == t::operation) {
+            throw "Equation contains too many successive operators (3+)";
+        }
+        if (tk[i].operation == o::subtract && tk[i+1].operation == o::subtract) {
+            tk[i].operation = o::add;
+            list.erase(i+1);
+        } else if (tk[i].operation == o::subtract && tk[i-1].type == t::operation) {
+            tk[i].operation = o::negate;
+        } else if (tk[i].operation == o::add && tk[i-1].operation == o::subtract) {
+            throw "Add operator following subtraction operator";
+        }
+    }
+}
+
+template <std::size_t N>
+constexpr int staticBuildGroup(const Literal<N>& equation, StaticPool<N>& pool, std::size_t begin, std::size_t end);
+
+// buildTree, for list.tokens[begin] up to list.tokens[end]
+template <std::size_t N>
+constexpr int staticBuild(const Literal<N>& equation, StaticPool<N>& pool, const StaticTokens<N>& list, std::size_t begin, std::size_t end) {
+    if (end <= begin) throw "Cannot create a tree from a zero-length TokenArr";
+
+    constexpr o orderedOperations[]{
+        o::add, o::subtract, o::modulo, o::multiply, o::divide, o::exponent, o::negate, o::function
+    };
+    for (const o currentOperation : orderedOperations) {
+        for (std::size_t i{ begin }; i < end; i++) {
+            const StaticToken& tk{ list.tokens[i] };
+            if (tk.type == t::operation && tk.operation == currentOperation) {
+                Instruction ins{ };
+                ins.operation = currentOperation;
+                ins.function = tk.function;
+                if (i > begin) ins.left = staticBuild(equation, pool, list, begin, i);
+                if (i+1 >= end) throw "Operator has no right operand!";
+                ins.right = staticBuild(equation, pool, list, i+1, end);
+                return pool.add(ins);
+            }
+        }
+    }
+
+    const StaticToken& first{ list.tokens[begin] };
+    Instruction ins{ };
+    if (first.type == t::group) {
+        return staticBuildGroup(equation, pool, first.begin, first.end);
+    } else if (first.type == t::number) {
+        ins.value = first.number;
+    } else if (first.type == t::variable) {
+        ins.isVariable = true;
+        ins.variable = first.variable;
+    } else {
+        throw "Cannot create TreeItem from given TokenArr. No valid operators or values.";
+    }
+    return pool.add(ins);
+}
+
+template <std::size_t N>
+constexpr int staticBuildGroup(const Literal<N>& equation, StaticPool<N>& pool, std::size_t begin, std::size_t end) {
+    StaticTokens<N> list{ staticTokenize(equation, begin, end) };
+    staticClean(list);
+    return staticBuild(equation, pool, list, 0, list.size);
+}
+
+template <Literal Equation>
+constexpr auto staticParse() {
+    StaticPool<sizeof(Equation.text)> pool{ };
+    pool.root = staticBuildGroup(Equation, pool, 0, sizeof(Equation.text) - 1);
+    return pool;
+}
+template <Literal Equation>
+constexpr auto staticPool{ staticParse<Equation>() };
+
+// Every StaticTree type derives from this
+struct StaticExpression { };
+
+// A missing operand
+struct StaticZero : StaticExpression {
+    static constexpr double solve(double, double, const Variables&) { return 0; }
+};
+template <double Value>
+struct StaticConstant : StaticExpression {
+    static constexpr double solve(double, double, const Variables&) { return Value; }
+};
+template <char Variable>
+struct StaticVariable : StaticExpression {
+    static constexpr double solve(double x, double y, const Variables& others) {
+        if constexpr (Variable == 'x') return x;
+        else if constexpr (Variable == 'y') return y;
+        else return others[Variable - 'a'];
+    }
+};
+template <o Operation, f Function, typename Left, typename Right>
+struct StaticOperation : StaticExpression {
+    static constexpr double solve(double x, double y, const Variables& others) {
+        double left{ Left::solve(x, y, others) };
+        double right{ Right::solve(x, y, others) };
+        if constexpr (Operation == o::add) return left + right;
+        else if constexpr (Operation == o::subtract) return left - right;
+        else if constexpr (Operation == o::negate) return -right;
+        else if constexpr (Operation == o::multiply) return left * right;
+        else if constexpr (Operation == o::divide) return left / right;
+        else if constexpr (Operation == o::modulo) return std::fmod(left, right);
+        else if constexpr (Operation == o::exponent) return std::pow(left, right);
+        else return doFunction(Function, left, right);
+    }
+};
+
+template <Literal Equation, int Index>
+constexpr auto staticNode() {
+    if constexpr (Index == -1) {
+        return StaticZero{ };
+    } else {
+        constexpr Instruction ins{ staticPool<Equation>.code[Index] };
+        if constexpr (ins.isVariable) {
+            return StaticVariable<ins.variable>{ };
+        } else if constexpr (ins.operation == o::none) {
+            return StaticConstant<ins.value>{ };
+        } else {
+            return StaticOperation<ins.operation, ins.function,
+                decltype(staticNode<Equation, ins.left>()),
+                decltype(staticNode<Equation, ins.right>())>{ };
+        }
+    }
+}
+
+// The type for an equation. Solve it with StaticTree<"...">::solve(x, y, others)
+template <Literal Equation>
+using StaticTree = decltype(staticNode<Equation, staticPool<Equation>.root>());
+
+// Solves a compile-time equation for a point, with any other variables in `variables`
+template <std::derived_from<StaticExpression> Tree>
+constexpr double solveStatic(Tree, const Variables& variables) {
+    return Tree::solve(variables['x'-'a'], variables['y'-'a'], variables);
+}
+
+// Same as solveBatch, for a compile-time equation. out gets one value per lane
+template <std::derived_from<StaticExpression> Tree>
+void solveBatch(Tree, const Batch& batch, std::vector<double>& out) {
+    out.resize(batch.size);
+    Variables others{ batch.variables };
+    auto xs{ batch.varying.find('x') };
+    auto ys{ batch.varying.find('y') };
+    if (batch.varying.size() == (std::size_t)(xs != batch.varying.end()) + (ys != batch.varying.end())) {
+        // Only x and/or y change, so the loop is just the equation
+        const double* x{ xs != batch.varying.end() ? xs->second.data() : nullptr };
+        const double* y{ ys != batch.varying.end() ? ys->second.data() : nullptr };
+        double fixedX{ others['x'-'a'] };
+        double fixedY{ others['y'-'a'] };
+        for (std::size_t lane{ 0 }; lane < batch.size; lane++) {
+            out[lane] = Tree::solve(x ? x[lane] : fixedX, y ? y[lane] : fixedY, others);
+        }
+        return;
+    }
+    for (std::size_t lane{ 0 }; lane < batch.size; lane++) {
+        for (const auto& [variable, values] : batch.varying) others[variable - 'a'] = values[lane];
+        out[lane] = Tree::solve(others['x'-'a'], others['y'-'a'], others);
+    }
+}
+
+// Same as createGrid, for a compile-time equation. Always solved with exact precision
+template <std::derived_from<StaticExpression> Tree>
+Grid createGrid(Tree, const Grid& settings) {
+    if (settings.startX >= settings.endX || settings.startY >= settings.endY) {
+        throw std::invalid_argument("Grid start positions must be less than end positions");
+    }
+    int xSteps{ gridColumns(settings) };
+    int ySteps{ gridRows(settings) };
+
+    Grid out{ settings };
+    out.points = { };
+    out.points.resize(xSteps, std::vector<double>(ySteps));
+    const Variables others{ };
+    for (int x{ 0 }; x < xSteps; x++) {
+        double xValue{ (x*settings.stepX) + settings.startX };
+        double* column{ out.points[x].data() };
+        for (int y{ 0 }; y < ySteps; y++) {
+            column[y] = Tree::solve(xValue, (y*settings.stepY) + settings.startY, others);
+        }
+    }
+    return out;
+}
+
+// The compile-time parser must give the same results as tokenize/clean/buildTree,
+// including how they group repeated operators
+namespace staticChecks {
+    constexpr Variables values{ [] {
+        Variables v{ };
+        v['x'-'a'] = 5;
+        v['y'-'a'] = 2;
+        v['a'-'a'] = 3;
+        return v;
+    }() };
+    static_assert(solveStatic(StaticTree<"1+2*3">{ }, values) == 7);
+    static_assert(solveStatic(StaticTree<"8-4-2">{ }, values) == 6);   // 8-(4-2)
+    static_assert(solveStatic(StaticTree<"8/4/2">{ }, values) == 4);   // 8/(4/2)
+    static_assert(solveStatic(StaticTree<"8/4*2">{ }, values) == 4);   // (8/4)*2, multiply splits first
+    static_assert(solveStatic(StaticTree<"x-y+1">{ }, values) == 4);   // (x-y)+1
+    static_assert(solveStatic(StaticTree<"2x 3">{ }, values) == 30);
+    static_assert(solveStatic(StaticTree<"-x+3">{ }, values) == -2);
+    static_assert(solveStatic(StaticTree<"x--y">{ }, values) == 7);
+    static_assert(solveStatic(StaticTree<"x*-y">{ }, values) == -10);
+    static_assert(solveStatic(StaticTree<"2(x+y)a">{ }, values) == 42);
+    static_assert(solveStatic(StaticTree<".5 + 1.25">{ }, values) == 1.75);
+    static_assert(solveStatic(StaticTree<"()">{ }, values) == 0);
+    static_assert(solveStatic(StaticTree<"ABS(y-x)*SIGN(-x)">{ }, values) == -3);
+}
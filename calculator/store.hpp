@@ -0,0 +1,251 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include "compile.hpp"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A saved equation: the text the user entered, its tree and the mode it was entered in
+// (m::equation, m::function or m::polar: parametric curves have two trees, and can't be saved)
+struct Save {
+    std::string name;
+    TreeItem tree;
+    m mode{ m::equation };
+};
+
+// Saved equations are kept in a binary file (native byte order):
+//   header:  "GCEQ", u32 version, u32 entry count
+//   entry:   u8 mode (see m), u32 source length, source text,
+//            u32 compiled length, compiled program (see writeProgram),
+//            u32 checksum of both (fnv1a)
+// Entries that fail to validate, or that were written by another version,
+// are parsed again from their source text. Version 1 entries have no mode, and are m::equation.
+const char storeMagic[4]{ 'G', 'C', 'E', 'Q' };
+const std::uint32_t storeVersion{ 2 };
+
+inline std::uint32_t fnv1a(const char* data, std::size_t size, std::uint32_t hash = 2166136261u) {
+    for (std::size_t i{ 0 }; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+template <typename T>
+void writeValue(std::string& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+// u32 instruction count, then for each instruction:
+// u8 operation, u8 function, u8 isVariable, u8 variable, f64 value, i32 left, i32 right.
+// Then u32 root count and i32 roots
+inline std::string writeProgram(const Program& program) {
+    std::string out{ };
+    writeValue<std::uint32_t>(out, program.code.size());
+    for (const Instruction& ins : program.code) {
+        writeValue<std::uint8_t>(out, (std::uint8_t)ins.operation);
+        writeValue<std::uint8_t>(out, (std::uint8_t)ins.function);
+        writeValue<std::uint8_t>(out, ins.isVariable);
+        writeValue<char>(out, ins.variable);
+        writeValue<double>(out, ins.value);
+        writeValue<std::int32_t>(out, ins.left);
+        writeValue<std::int32_t>(out, ins.right);
+    }
+    writeValue<std::uint32_t>(out, program.roots.size());
+    for (const int root : program.roots) writeValue<std::int32_t>(out, root);
+    return out;
+}
+
+// Reads values out of a block of memory. Reading past the end sets ok to false.
+struct StoreReader {
+    const char* data{ nullptr };
+    std::size_t size{ 0 };
+    std::size_t pos{ 0 };
+    bool ok{ true };
+
+    template <typename T>
+    T read() {
+        T value{ };
+        if (!ok || size - pos < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    // Returns a pointer to the next `length` bytes and skips them
+    const char* skip(std::size_t length) {
+        if (!ok || size - pos < length) {
+            ok = false;
+            return nullptr;
+        }
+        pos += length;
+        return data + pos - length;
+    }
+};
+
+// Reads a program written by writeProgram, checking every instruction is usable.
+// Returns false if anything is out of range.
+inline bool readProgram(StoreReader reader, Program& program) {
+    std::uint32_t count{ reader.read<std::uint32_t>() };
+    if (!reader.ok || count > reader.size / 20) return false;
+    program = { };
+    program.code.resize(count);
+    for (std::uint32_t i{ 0 }; i < count; i++) {
+        Instruction& ins{ program.code[i] };
+        std::uint8_t operation{ reader.read<std::uint8_t>() };
+        std::uint8_t function{ reader.read<std::uint8_t>() };
+        std::uint8_t isVariable{ reader.read<std::uint8_t>() };
+        ins.variable = reader.read<char>();
+        ins.value = reader.read<double>();
+        ins.left = reader.read<std::int32_t>();
+        ins.right = reader.read<std::int32_t>();
+        if (!reader.ok || operation > (std::uint8_t)o::modulo || function > (std::uint8_t)f::e || isVariable > 1) return false;
+        ins.operation = (o)operation;
+        ins.function = (f)function;
+        ins.isVariable = isVariable;
+        if (ins.isVariable && (ins.variable < 'a' || ins.variable > 'z')) return false;
+        // Operands must come first
+        if (ins.left < -1 || ins.left >= (std::int32_t)i || ins.right < -1 || ins.right >= (std::int32_t)i) return false;
+
+        if (ins.isVariable) ins.reads = varBit(ins.variable);
+        if (ins.left != -1) ins.reads |= program.code[ins.left].reads;
+        if (ins.right != -1) ins.reads |= program.code[ins.right].reads;
+    }
+    std::uint32_t roots{ reader.read<std::uint32_t>() };
+    if (!reader.ok || roots > count) return false;
+    for (std::uint32_t i{ 0 }; i < roots; i++) {
+        std::int32_t root{ reader.read<std::int32_t>() };
+        if (root < 0 || root >= (std::int32_t)count) return false;
+        program.roots.push_back(root);
+    }
+    return reader.ok && reader.pos == reader.size;
+}
+
+// Turns part of a program back into a tree
+inline TreeItem decompile(const Program& program, int index) {
+    const Instruction& ins{ program.code.at(index) };
+    TreeItem item{ };
+    if (ins.isVariable) {
+        item.isVariable = true;
+        item.variable = ins.variable;
+    } else if (ins.operation == o::none) {
+        item.solved = true;
+        item.value = ins.value;
+    } else {
+        item.operation = ins.operation;
+        if (ins.operation == o::function) item.function = fAsString(ins.function);
+        if (ins.left != -1) item.left = new TreeItem{ decompile(program, ins.left) };
+        if (ins.right != -1) item.right = new TreeItem{ decompile(program, ins.right) };
+    }
+    return item;
+}
+
+// Writes every saved equation to the file at path, replacing it.
+// Returns false if the file couldn't be written.
+inline bool saveEquations(const std::string& path, const std::vector<Save>& saves) {
+    std::string out(storeMagic, sizeof(storeMagic));
+    writeValue<std::uint32_t>(out, storeVersion);
+    writeValue<std::uint32_t>(out, saves.size());
+    for (const Save& save : saves) {
+        std::string compiled{ writeProgram(compileTree(save.tree)) };
+        writeValue<std::uint8_t>(out, (std::uint8_t)save.mode);
+        writeValue<std::uint32_t>(out, save.name.size());
+        out += save.name;
+        writeValue<std::uint32_t>(out, compiled.size());
+        out += compiled;
+        writeValue<std::uint32_t>(out, fnv1a(compiled.data(), compiled.size(), fnv1a(save.name.data(), save.name.size())));
+    }
+
+    // Write next to the file and then replace it, so a crash never leaves half a file
+    std::string temporary{ path + ".tmp" };
+    {
+        std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+        if (!file.write(out.data(), out.size())) return false;
+    }
+    std::error_code error{ };
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+// Reads the saved equations from the file at path. A missing file is just no equations.
+// reparsed is set to how many equations had to be parsed again from their source text.
+inline std::vector<Save> loadEquations(const std::string& path, int& reparsed) {
+    std::vector<Save> saves{ };
+    reparsed = 0;
+
+    std::string buffer{ };
+    const char* data{ nullptr };
+    std::size_t size{ 0 };
+#ifndef _WIN32
+    int fd{ ::open(path.c_str(), O_RDONLY) };
+    if (fd < 0) return saves;
+    struct stat info{ };
+    void* mapped{ MAP_FAILED };
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        size = (std::size_t)info.st_size;
+        mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) return saves;
+    data = (const char*)mapped;
+#else
+    std::ifstream file{ path, std::ios::binary };
+    if (!file) return saves;
+    buffer.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{ });
+    data = buffer.data();
+    size = buffer.size();
+#endif
+
+    StoreReader reader{ data, size };
+    const char* magic{ reader.skip(sizeof(storeMagic)) };
+    std::uint32_t version{ reader.read<std::uint32_t>() };
+    std::uint32_t count{ reader.read<std::uint32_t>() };
+    if (reader.ok && std::memcmp(magic, storeMagic, sizeof(storeMagic)) == 0) {
+        for (std::uint32_t i{ 0 }; i < count && reader.ok; i++) {
+            std::uint8_t mode{ version >= 2 ? reader.read<std::uint8_t>() : (std::uint8_t)m::equation };
+            std::uint32_t sourceSize{ reader.read<std::uint32_t>() };
+            const char* source{ reader.skip(sourceSize) };
+            std::uint32_t compiledSize{ reader.read<std::uint32_t>() };
+            const char* compiled{ reader.skip(compiledSize) };
+            std::uint32_t checksum{ reader.read<std::uint32_t>() };
+            if (!reader.ok) break; // Can't tell where the next entry starts
+
+            Save save{ .name = std::string{ source, sourceSize }, .tree = { }, .mode = (m)mode };
+            if (mode > (std::uint8_t)m::polar || save.mode == m::parametric) {
+                std::cout << "<!> [loadEquations:2] Dropping saved equation " << save.name << " with an unknown mode\n";
+                continue;
+            }
+            Program program{ };
+            bool valid{ version == storeVersion
+                && checksum == fnv1a(compiled, compiledSize, fnv1a(source, sourceSize))
+                && readProgram({ compiled, compiledSize }, program)
+                && program.roots.size() == 1 };
+            if (valid) {
+                save.tree = decompile(program, program.roots[0]);
+            } else if (parseSource(save.name, save.tree)) {
+                reparsed++;
+            } else {
+                std::cout << "<!> [loadEquations:0] Dropping unreadable saved equation " << save.name << "\n";
+                continue;
+            }
+            saves.push_back(save);
+        }
+    } else {
+        std::cout << "<!> [loadEquations:1] " << path << " is not a saved equations file\n";
+    }
+
+#ifndef _WIN32
+    ::munmap((void*)data, size);
+#endif
+    return saves;
+}
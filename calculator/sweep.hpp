@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <thread>
+#include "grid.hpp"
+
+// A parameter (any variable other than x and y) and the range to sweep it over.
+// Ranges are inclusive, like grids.
+struct Sweep {
+    char variable{ 'a' };
+    double start{ 0 };
+    double end{ 1 };
+    double step{ 1 };
+};
+
+// Every combination of the swept values, one Variables per frame.
+// The last sweep changes fastest.
+inline std::vector<Variables> sweepValues(const std::vector<Sweep>& sweeps) {
+    std::vector<Variables> frames{ Variables{ } };
+    for (const Sweep& sweep : sweeps) {
+        int steps{ (int)std::floor((sweep.end - sweep.start)/sweep.step + 1) };
+        std::vector<Variables> next{ };
+        for (const Variables& frame : frames) {
+            for (int i{ 0 }; i < steps; i++) {
+                Variables values{ frame };
+                values[sweep.variable - 'a'] = i*sweep.step + sweep.start;
+                next.push_back(values);
+            }
+        }
+        frames = next;
+    }
+    return frames;
+}
+
+// Creates one grid for each frame of parameter values (see sweepValues).
+// Parts of the equation that don't read any swept parameter are solved once for the
+// whole sweep, then the frames are split between threads.
+inline std::vector<Grid> createSweep(const TreeItem& equation, const Grid& settings, const std::vector<Variables>& frames, const std::vector<Sweep>& sweeps) {
+    if (settings.startX >= settings.endX || settings.startY >= settings.endY) {
+        throw std::invalid_argument("Grid start positions must be less than end positions");
+    }
+    int xSteps{ gridColumns(settings) };
+    int ySteps{ gridRows(settings) };
+
+    unsigned int swept{ 0 };
+    for (const Sweep& sweep : sweeps) swept |= varBit(sweep.variable);
+
+    Program program{ compileTree(equation) };
+    auto isSwept{ [&](const Instruction& ins) { return (ins.reads & swept) != 0; } };
+
+    // The unswept instructions that swept ones (or the result) read. Only these need to be kept.
+    std::vector<int> kept{ };
+    for (std::size_t i{ 0 }; i < program.code.size(); i++) {
+        const Instruction& ins{ program.code[i] };
+        if (!isSwept(ins)) continue;
+        for (const int side : { ins.left, ins.right }) {
+            if (side != -1 && !isSwept(program.code[side])) kept.push_back(side);
+        }
+    }
+    if (!isSwept(program.code[program.roots[0]])) kept.push_back(program.roots[0]);
+    std::sort(kept.begin(), kept.end());
+    kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+
+    Batch batch{ .size = (std::size_t)ySteps, .precision = settings.precision };
+    std::vector<double>& ys{ batch.varying['y'] };
+    for (int y{ 0 }; y < ySteps; y++) {
+        ys.push_back((y*settings.stepY) + settings.startY);
+    }
+
+    // Solve the unswept part once, keeping the lanes swept instructions need for each column
+    std::vector<Lanes> unswept(xSteps);
+    {
+        Lanes lanes{ };
+        for (int x{ 0 }; x < xSteps; x++) {
+            batch.variables['x'-'a'] = (x*settings.stepX) + settings.startX;
+            solveBatchWhere(program, batch, lanes, [&](const Instruction& ins) {
+                return !isSwept(ins) && (x == 0 || (ins.reads & varBit('x')));
+            });
+            unswept[x].resize(program.code.size());
+            for (const int i : kept) unswept[x][i] = lanes[i];
+        }
+    }
+
+    std::vector<Grid> out(frames.size(), settings);
+    auto solveFrames{ [&](std::size_t first, std::size_t every) {
+        Batch frameBatch{ batch };
+        Lanes lanes{ };
+        for (std::size_t frame{ first }; frame < frames.size(); frame += every) {
+            Grid& grid{ out[frame] };
+            grid.points = { };
+            grid.points.resize(xSteps, std::vector<double>(ySteps));
+            frameBatch.variables = frames[frame];
+
+            for (int x{ 0 }; x < xSteps; x++) {
+                frameBatch.variables['x'-'a'] = (x*settings.stepX) + settings.startX;
+                lanes = unswept[x];
+                solveBatchWhere(program, frameBatch, lanes, isSwept);
+
+                std::vector<double>& column{ grid.points[x] };
+                for (int y{ 0 }; y < ySteps; y++) {
+                    column[y] = laneValue(lanes, program.roots[0], y);
+                }
+            }
+        }
+    } };
+
+    std::size_t threadCount{ std::max<std::size_t>(1, std::min<std::size_t>(std::thread::hardware_concurrency(), frames.size())) };
+    std::vector<std::thread> threads{ };
+    for (std::size_t t{ 1 }; t < threadCount; t++) {
+        threads.emplace_back(solveFrames, t, threadCount);
+    }
+    solveFrames(0, threadCount);
+    for (std::thread& thread : threads) thread.join();
+
+    return out;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cmath>
+#include "compile.hpp"
+
+// Proving equations are symmetric in a variable, from their compiled program, so grids only need to
+// solve one half of the window and mirror the other (see gridSymmetry).
+// Even means f(-v) = f(v) (eg x^2, ABS(x), COS(x)), odd means f(-v) = -f(v) (eg x^3, SIN(x)). Both
+// hold in floating point too, since negating a value doesn't change how it's rounded (up to the last
+// bit of some built-in functions).
+// Anything the rules below don't cover is neither, and gets solved in full.
+
+enum class Parity {
+    independent, // doesn't read the variable
+    even,
+    odd,
+    neither
+};
+
+// Parity of a product or quotient: the signs multiply
+inline Parity parityProduct(Parity a, Parity b) {
+    if (a == Parity::neither || b == Parity::neither) return Parity::neither;
+    if (a == Parity::independent) return b;
+    if (b == Parity::independent) return a;
+    return a == b ? Parity::even : Parity::odd;
+}
+
+// Parity of a sum or difference: only terms with the same parity keep it
+inline Parity paritySum(Parity a, Parity b) {
+    if (a == Parity::neither || b == Parity::neither) return Parity::neither;
+    if (a == Parity::independent) return b == Parity::odd ? Parity::neither : b;
+    if (b == Parity::independent) return a == Parity::odd ? Parity::neither : a;
+    return a == b ? a : Parity::neither;
+}
+
+// Parity of a function of an odd value
+inline Parity parityOfOdd(f function) {
+    switch (function) {
+        case f::sin:
+        case f::tan:
+        case f::asin:
+        case f::atan:
+        case f::cbrt:
+        case f::sign:
+        case f::even: // fmod keeps the sign of the value
+            return Parity::odd;
+        case f::cos:
+        case f::abs:
+            return Parity::even;
+        case f::none:
+            return Parity::independent; // always 0
+        default:
+            return Parity::neither;
+    }
+}
+
+// The parity of each instruction of a program in a variable. Operands come before the instructions
+// that use them, so this is one pass
+inline std::vector<Parity> programParity(const Program& program, char variable) {
+    std::vector<Parity> out(program.code.size(), Parity::independent);
+    for (std::size_t i{ 0 }; i < program.code.size(); i++) {
+        const Instruction& ins{ program.code[i] };
+        if ((ins.reads & varBit(variable)) == 0) continue;
+        if (ins.isVariable) {
+            out[i] = Parity::odd;
+            continue;
+        }
+        Parity left{ ins.left != -1 ? out[ins.left] : Parity::independent };
+        Parity right{ ins.right != -1 ? out[ins.right] : Parity::independent };
+        switch (ins.operation) {
+            case o::add:
+            case o::subtract:
+                out[i] = paritySum(left, right);
+                break;
+            case o::negate:
+                out[i] = right;
+                break;
+            case o::multiply:
+            case o::divide:
+                out[i] = parityProduct(left, right);
+                break;
+            case o::modulo:
+                // fmod(-a, b) = -fmod(a, b) and fmod(a, -b) = fmod(a, b)
+                out[i] = right == Parity::neither ? Parity::neither : left == Parity::independent ? Parity::even : left;
+                break;
+            case o::exponent: {
+                if (left == Parity::independent || left == Parity::even) {
+                    out[i] = right == Parity::independent || right == Parity::even ? Parity::even : Parity::neither;
+                    break;
+                }
+                // An odd base to a whole power: even for even powers, odd for odd ones
+                out[i] = Parity::neither;
+                if (left != Parity::odd || ins.right == -1 || right != Parity::independent) break;
+                const Instruction& power{ program.code[ins.right] };
+                if (power.operation != o::none || power.isVariable || power.value != std::floor(power.value)) break;
+                out[i] = std::fmod(power.value, 2) == 0 ? Parity::even : Parity::odd;
+                break;
+            }
+            case o::function:
+                // Any function of an even value is even
+                out[i] = right == Parity::odd ? parityOfOdd(ins.function) : right;
+                break;
+            default:
+                out[i] = Parity::neither;
+        }
+    }
+    return out;
+}
@@ -1,8 +1,10 @@
 #pragma once
 #include <regex>
+#include <stdexcept>
 #include "def.hpp"
 
-TokenArr tokenize(std::string equation, bool& error) {
+// Messages about problems with the equation are written to log
+inline TokenArr tokenize(std::string equation, bool& error, std::ostream& log = std::cout) {
     TokenArr out{ };
     const std::regex rGroup{ "^\\(" };
     const std::regex rNumber{ "^(\\d+(\\.\\d+)?|\\.\\d+)" };
@@ -28,7 +30,7 @@ TokenArr tokenize(std::string equation, bool& error) {
                 case '^': newTk.operation = o::exponent; break;
                 case '%': newTk.operation = o::modulo; break;
                 default:
-                    std::cout << "<!> [tokenize:0] Unknown operator " << match.str() << "\n";
+                    log << "<!> [tokenize:0] Unknown operator " << match.str() << "\n";
                     error = true;
             }
             out.push_back(newTk);
@@ -60,11 +62,11 @@ TokenArr tokenize(std::string equation, bool& error) {
                 pos++;
             }
             if (depth > 0) {
-                std::cout << "<!> [tokenize:1] Unmatched parentheses: " << equation << '\n';
+                log << "<!> [tokenize:1] Unmatched parentheses: " << equation << '\n';
                 error = true;
                 break;
             }
-            newTk.group = tokenize(equation.substr(1, pos-1), error);
+            newTk.group = tokenize(equation.substr(1, pos-1), error, log);
             out.push_back(newTk);
             equation = equation.substr(pos, equation.size());
             
@@ -72,7 +74,7 @@ TokenArr tokenize(std::string equation, bool& error) {
             // No match and not whitespace
             if (equation.size() > 0) {
                 // It's only a problem if we're not done already.
-                std::cout << "<!> [tokenize:2] Cannot parse part of equation: " << equation << '\n';
+                log << "<!> [tokenize:2] Cannot parse part of equation: " << equation << '\n';
                 error = true;
             }
             break;
@@ -80,7 +82,7 @@ TokenArr tokenize(std::string equation, bool& error) {
         try {
             equation = equation.substr(match.length(), equation.size());
         } catch (std::out_of_range const&) {
-            std::cout << "<!> [tokenize:3] Abrupt end of equation! " << equation << '\n';
+            log << "<!> [tokenize:3] Abrupt end of equation! " << equation << '\n';
             error = true;
             return out;
         }
@@ -91,9 +93,9 @@ TokenArr tokenize(std::string equation, bool& error) {
 /** Prepares a TokenArr for parsing. OPERATES DIRECTLY ON THE PASSED LIST
  * - replaces o::subtract with o::negate or o::add o::negate
  */
-bool clean(TokenArr& list) {
+inline bool clean(TokenArr& list, std::ostream& log = std::cout) {
     if (list.size() < 1) {
-        std::cout << "(I) [clean:2] Equation or group is zero-length, adding implicit 0.\n";
+        log << "(I) [clean:2] Equation or group is zero-length, adding implicit 0.\n";
         Token newTk{ t::number };
         newTk.number = 0;
         list.push_back(newTk);
@@ -105,7 +107,7 @@ bool clean(TokenArr& list) {
         list.at(0).operation = o::negate;
     }
     if (list.at(list.size()-1).type == t::operation) {
-        std::cout << "<!> [clean:0] Equation contains a trailing operator\n";
+        log << "<!> [clean:0] Equation contains a trailing operator\n";
         return false;
     }
 
@@ -113,7 +115,7 @@ bool clean(TokenArr& list) {
         if (list.at(i).type == t::group) {
             // Recursively clean groups
             // Fail if groups fails
-            if (!clean(list.at(i).group)) return false;
+            if (!clean(list.at(i).group, log)) return false;
         }
 
         // The following checks assume they start on the second element,
@@ -137,7 +139,7 @@ bool clean(TokenArr& list) {
             list.at(i-1).type == t::operation &&
             list.at(i+1).type == t::operation)
         {
-            std::cout << "<!> [clean:1] Equation contains too many successive operators (3+) at position " << i << '\n';
+            log << "<!> [clean:1] Equation contains too many successive operators (3+) at position " << i << '\n';
             return false;
         }
 
@@ -151,7 +153,7 @@ bool clean(TokenArr& list) {
             list.at(i).operation = o::negate;
 
         } else if (list.at(i).operation == o::add && list.at(i-1).operation == o::subtract) {
-            std::cout << "<!> [clean:3] Add operator following subtraction operator. You probably meant a+-b" << i << '\n';
+            log << "<!> [clean:3] Add operator following subtraction operator. You probably meant a+-b" << i << '\n';
             return false;
         }
     }
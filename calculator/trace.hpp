@@ -0,0 +1,211 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cmath>
+#include "function.hpp"
+
+// Graphs of equations found by following the curve, instead of solving every point (see e::trace).
+// The equation is solved around the edge of the window and on a grid 8 times coarser than the window
+// to find where it changes sign, and each of those is narrowed down to a point on the curve. From there the curve is followed both
+// ways: a step along the tangent (predictor), then Newton's method back onto the curve (corrector).
+// Steps get longer where the curve is straight and shorter where it bends, so the values solved grow
+// with the length of the curve on screen, not with the size of the window.
+// Curves that fit between the coarse points without crossing them (tiny loops) can be missed.
+// The output is a curve grid, like createParametric's, drawn with drawCurve.
+
+// An equation solved one point at a time, in cells: u columns from startX and v rows from startY.
+// Always solves in double precision
+struct Tracer {
+    const Program& program;
+    const Grid& settings;
+    Variables variables{ };
+    std::vector<double> registers{ };
+    std::size_t solved{ 0 };
+
+    double at(double u, double v) {
+        variables['x'-'a'] = settings.startX + u*settings.stepX;
+        variables['y'-'a'] = settings.startY + v*settings.stepY;
+        registers.resize(program.code.size());
+        solveProgram(program, variables, registers);
+        solved++;
+        return registers[program.roots[0]];
+    }
+    // By central differences, a 64th of a cell each way
+    std::array<double, 2> gradient(double u, double v) {
+        const double h{ 1.0 / 64 };
+        return { (at(u+h, v) - at(u-h, v)) / (2*h), (at(u, v+h) - at(u, v-h)) / (2*h) };
+    }
+    // Moves (u, v) onto the curve with Newton's method along the gradient, and sets tangent to the
+    // unit tangent there. Returns false if it isn't within a thousandth of a cell after a few steps
+    bool correct(double& u, double& v, std::array<double, 2>& tangent) {
+        for (int i{ 0 }; i < 6; i++) {
+            double value{ at(u, v) };
+            auto [gu, gv]{ gradient(u, v) };
+            double size{ gu*gu + gv*gv };
+            if (!std::isfinite(value) || !std::isfinite(size) || size == 0) return false;
+            double du{ value*gu / size };
+            double dv{ value*gv / size };
+            u -= du;
+            v -= dv;
+            tangent = { -gv / std::sqrt(size), gu / std::sqrt(size) };
+            if (du*du + dv*dv < 1e-6) return true;
+        }
+        return false;
+    }
+};
+
+// Solves a compiled equation's curve by tracing it (see above). out.solved says how many values it took.
+// If cancel gets set, the grid is left unfinished.
+inline Grid createTrace(const Program& program, const Grid& settings, const std::atomic<bool>* cancel = nullptr) {
+    const int xSteps{ gridColumns(settings) };
+    const int ySteps{ gridRows(settings) };
+    Grid out{ settings };
+    out.points = { };
+    out.points.resize(xSteps);
+    std::vector<std::vector<char>> marked(xSteps, std::vector<char>(ySteps, false));
+    Tracer tracer{ program, settings };
+
+    auto cellMarked{ [&](double u, double v) {
+        int x{ (int)std::round(u) };
+        int y{ (int)std::round(v) };
+        return x >= 0 && x < xSteps && y >= 0 && y < ySteps && marked[x][y];
+    } };
+    // Marks every cell a line between two points on the curve passes through
+    auto markLine{ [&](double u0, double v0, double u1, double v1) {
+        int parts{ 1 + (int)(4 * std::max(std::abs(u1 - u0), std::abs(v1 - v0))) };
+        for (int i{ 0 }; i <= parts; i++) {
+            int x{ (int)std::round(u0 + (u1 - u0) * i / parts) };
+            int y{ (int)std::round(v0 + (v1 - v0) * i / parts) };
+            if (x >= 0 && x < xSteps && y >= 0 && y < ySteps) marked[x][y] = true;
+        }
+    } };
+
+    // Follows the curve from a point on it, one way (direction 1 or -1). Returns true if it came back round
+    // to where it started (a closed loop, so there's no need to go the other way)
+    const double longest{ 4 };
+    const double shortest{ 1.0 / 64 };
+    const double cosTurn{ std::cos(0.35) }; // steps that turn more than 20 degrees are too long
+    const double cosStraight{ std::cos(0.17) }; // and ones that turn less than 10 could be longer
+    const int mostSteps{ 1 << 20 };
+    auto follow{ [&](double u, double v, std::array<double, 2> tangent, double direction) {
+        const double startU{ u };
+        const double startV{ v };
+        tangent = { tangent[0] * direction, tangent[1] * direction };
+        double step{ 1 };
+        double travelled{ 0 };
+        for (int i{ 0 }; i < mostSteps; i++) {
+            // Off the window (by more than a cell)
+            if (u < -1 || v < -1 || u > xSteps || v > ySteps) return false;
+
+            double nextU{ u + step*tangent[0] };
+            double nextV{ v + step*tangent[1] };
+            std::array<double, 2> nextTangent{ };
+            bool ok{ tracer.correct(nextU, nextV, nextTangent) };
+            // Keep going the same way along the curve
+            double turn{ nextTangent[0]*tangent[0] + nextTangent[1]*tangent[1] };
+            if (turn < 0) {
+                nextTangent = { -nextTangent[0], -nextTangent[1] };
+                turn = -turn;
+            }
+            double moved{ std::hypot(nextU - u, nextV - v) };
+            // Corrected by more than half a cell, it could have landed on a neighbouring curve
+            double corrected{ std::hypot(nextU - u - step*tangent[0], nextV - v - step*tangent[1]) };
+            if (!ok || turn < cosTurn || corrected > 0.5) {
+                if (step > shortest) {
+                    step /= 2;
+                    continue;
+                }
+                // Still lost at the shortest step: a branch point (where the curve crosses itself, the
+                // gradient is 0), or the curve ends. Try to jump over it in a straight line
+                nextU = u + 2*tangent[0];
+                nextV = v + 2*tangent[1];
+                if (!tracer.correct(nextU, nextV, nextTangent)) return false;
+                if (nextTangent[0]*tangent[0] + nextTangent[1]*tangent[1] < 0) nextTangent = { -nextTangent[0], -nextTangent[1] };
+                if (nextTangent[0]*tangent[0] + nextTangent[1]*tangent[1] < cosTurn) return false;
+                moved = std::hypot(nextU - u, nextV - v);
+                step = 1;
+            } else if (turn > cosStraight) {
+                step = std::min(longest, step * 1.5);
+            }
+
+            markLine(u, v, nextU, nextV);
+            travelled += moved;
+            u = nextU;
+            v = nextV;
+            tangent = nextTangent;
+            if (travelled > 3*step && std::hypot(u - startU, v - startV) < step) {
+                markLine(u, v, startU, startV);
+                return true;
+            }
+        }
+        return false;
+    } };
+
+    // Find sign changes between neighbouring points of the coarse grid, and trace from each (unless
+    // a curve already traced goes through it). Every point around the edge of the window is solved too,
+    // so every curve that crosses into the window is found
+    const int spacing{ 8 };
+    Grid coarse{ settings };
+    coarse.mode = m::equation;
+    coarse.precision = p::exact;
+    coarse.stepX *= spacing;
+    coarse.stepY *= spacing;
+    coarse.endX += coarse.stepX;
+    coarse.endY += coarse.stepY;
+    Grid values{ std::move(createOverlay(program, coarse, cancel).at(0)) };
+    tracer.solved += gridColumns(coarse) * gridRows(coarse);
+
+    auto seed{ [&](double u0, double v0, double a, double u1, double v1, double b) {
+        const double length{ std::max(std::abs(u1 - u0), std::abs(v1 - v0)) };
+        if (!std::isfinite(a) || !std::isfinite(b) || (a < 0) == (b < 0)) return;
+        // Halve the gap until it's a thousandth of a cell wide
+        double low{ 0 };
+        double high{ 1 };
+        double lowValue{ a };
+        double value{ a };
+        while ((high - low) * length > 1e-3) {
+            double middle{ (low + high) / 2 };
+            value = tracer.at(u0 + (u1 - u0)*middle, v0 + (v1 - v0)*middle);
+            if ((value < 0) == (lowValue < 0)) {
+                low = middle;
+                lowValue = value;
+            } else {
+                high = middle;
+            }
+        }
+        // A sign change that gets bigger closer up is a pole (eg of TAN), not the curve
+        if (!(std::abs(value) <= std::max(std::abs(a), std::abs(b)))) return;
+        double u{ u0 + (u1 - u0)*low };
+        double v{ v0 + (v1 - v0)*low };
+        if (cellMarked(u, v)) return;
+        std::array<double, 2> tangent{ };
+        if (!tracer.correct(u, v, tangent)) return;
+        if (!follow(u, v, tangent, 1)) follow(u, v, tangent, -1);
+    } };
+    std::vector<std::array<double, 2>> edge{ };
+    for (int x{ 0 }; x < xSteps; x++) edge.push_back({ (double)x, 0 });
+    for (int y{ 1 }; y < ySteps; y++) edge.push_back({ (double)xSteps-1, (double)y });
+    for (int x{ xSteps-2 }; x >= 0; x--) edge.push_back({ (double)x, (double)ySteps-1 });
+    for (int y{ ySteps-2 }; y >= 0; y--) edge.push_back({ 0, (double)y });
+    std::vector<double> edgeValues{ };
+    for (const auto& [u, v] : edge) edgeValues.push_back(tracer.at(u, v));
+    for (std::size_t i{ 0 }; i+1 < edge.size(); i++) {
+        if (cancel != nullptr && *cancel) return out;
+        seed(edge[i][0], edge[i][1], edgeValues[i], edge[i+1][0], edge[i+1][1], edgeValues[i+1]);
+    }
+
+    for (int x{ 0 }; x < (int)values.points.size(); x++) {
+        if (cancel != nullptr && *cancel) return out;
+        const std::vector<double>& column{ values.points[x] };
+        for (int y{ 0 }; y < (int)column.size(); y++) {
+            double u{ (double)x * spacing };
+            double v{ (double)y * spacing };
+            if (y+1 < (int)column.size()) seed(u, v, column[y], u, v + spacing, column[y+1]);
+            if (x+1 < (int)values.points.size()) seed(u, v, column[y], u + spacing, v, values.points[x+1][y]);
+        }
+    }
+
+    addMarkedRanges(out, marked);
+    out.solved = tracer.solved;
+    return out;
+}
@@ -1,7 +1,10 @@
 #pragma once
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
 #include "tokens.hpp"
 
-TreeItem buildTree(const TokenArr& list) {
+inline TreeItem buildTree(const TokenArr& list, std::ostream& log = std::cout) {
     TreeItem root{ };
     if (list.size() < 1) {
         throw std::invalid_argument("Cannot create a tree from a zero-length TokenArr");
@@ -28,10 +31,10 @@ TreeItem buildTree(const TokenArr& list) {
                 std::copy(list.begin(), list.begin() + i, std::back_inserter(left));
                 std::copy(list.begin() + i+1, list.end(), std::back_inserter(right)); // +1 to not include the operation
                 if (left.size() > 0) { // unary operators don't need a left
-                    root.left = new TreeItem{ buildTree(left) };
+                    root.left = new TreeItem{ buildTree(left, log) };
                 }
                 if (right.size() < 1) throw ("Operator has no right operand!");
-                root.right = new TreeItem{ buildTree(right) };
+                root.right = new TreeItem{ buildTree(right, log) };
 
                 return root;
             }
@@ -39,7 +42,7 @@ TreeItem buildTree(const TokenArr& list) {
     }
     if (list.at(0).type == t::group) {
         // Just a group? return the group.
-        return buildTree(list.at(0).group);
+        return buildTree(list.at(0).group, log);
     } else if (list.at(0).type == t::number) {
         root.solved = true;
         root.value = list.at(0).number;
@@ -53,15 +56,41 @@ TreeItem buildTree(const TokenArr& list) {
     }
 
     if (list.size() > 1) {
-        std::cout << "<?> [buildTree:0] List contains multiple values with no operation!\n";
+        log << "<?> [buildTree:0] List contains multiple values with no operation!\n";
         for (const Token& tk : list) {
-            printToken(tk);
+            printToken(tk, log);
         }
     }
     return root;
 }
 
-void printTree(const TreeItem& item, int indentation = 0, std::string pos = "0") {
+// Tokenizes, cleans and builds a tree. Returns false if the equation can't be parsed,
+// with the reason written to log
+inline bool parseSource(const std::string& source, TreeItem& tree, std::ostream& log = std::cout) {
+    bool error{ false };
+    TokenArr tokenized{ tokenize(source, error, log) };
+    if (error || !clean(tokenized, log)) return false;
+    try {
+        tree = buildTree(tokenized, log);
+    } catch (const char* message) {
+        log << "<!> [parseSource:0] " << message << "\n";
+        return false;
+    } catch (const std::exception& exception) {
+        log << "<!> [parseSource:0] " << exception.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Copies a tree, including every item below it
+inline TreeItem copyTree(const TreeItem& item) {
+    TreeItem copy{ item };
+    if (item.left != nullptr) copy.left = new TreeItem{ copyTree(*item.left) };
+    if (item.right != nullptr) copy.right = new TreeItem{ copyTree(*item.right) };
+    return copy;
+}
+
+inline void printTree(const TreeItem& item, int indentation = 0, std::string pos = "0") {
     std::string indent( indentation*4, ' ' );
     std::string indentNext( (indentation+1)*4, ' ' );
     std::cout << indent << pos << " = "
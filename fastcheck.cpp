@@ -0,0 +1,113 @@
+// Checks the fast function kernels (calculator/fastmath.hpp) against the standard library.
+// Build: g++ fastcheck.cpp -o fastcheck -std=c++20 -O2
+// Run:   ./fastcheck [samples per function]
+//
+// Each kernel's worst error over random inputs (the same ones every run) is compared with the bound
+// documented in fastmath.hpp, then graphs of a few equations in fast precision are compared with exact
+// precision (see checkPrecision). Prints a line per check, and exits with 1 if any of them fails.
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "calculator/library.hpp"
+
+int main(int argc, char** argv) {
+    int samples{ argc > 1 ? std::stoi(argv[1]) : 2000000 };
+    std::mt19937_64 random{ 1 };
+    auto uniform{ [&](double low, double high) { return std::uniform_real_distribution<double>{ low, high }(random); } };
+    // Spread evenly over the powers of 10 from low to high, either sign if signed
+    auto spread{ [&](double low, double high, bool signed_) {
+        double value{ std::exp(uniform(std::log(low), std::log(high))) };
+        return signed_ && random() % 2 == 0 ? -value : value;
+    } };
+    bool failed{ false };
+
+    struct Kernel {
+        std::string name;
+        double bound;
+        std::function<double()> input;
+        std::function<double(double)> error; // of one input, in the same terms as the bound
+    };
+    auto absolute{ [](double fast, double exact) { return std::abs(fast - exact); } };
+    auto relative{ [](double fast, double exact) { return std::abs(fast / exact - 1); } };
+    auto logError{ [](double fast, double exact) { return std::abs(fast - exact) / (1 + std::abs(exact)); } };
+    // Bounds as documented in calculator/fastmath.hpp
+    const std::vector<Kernel> kernels{
+        { "fastSin", 1e-15, [&] { return spread(1e-8, 1e6, true); }, [&](double x) { return absolute(fastSin(x), std::sin(x)); } },
+        { "fastCos", 1e-15, [&] { return uniform(-1e6, 1e6); }, [&](double x) { return absolute(fastCos(x), std::cos(x)); } },
+        { "fastTan", 2e-15, [&] { return uniform(-1e6, 1e6); }, [&](double x) { return relative(fastTan(x), std::tan(x)); } },
+        // Next to the poles and zeroes, where TAN divides by a tiny reduced value
+        { "fastTan", 2e-15, [&] { return std::round(uniform(-6e5, 6e5)) * (std::numbers::pi/2) + spread(1e-12, 1e-3, true); },
+            [&](double x) { return relative(fastTan(x), std::tan(x)); } },
+        { "fastAtan", 1e-10, [&] { return spread(1e-10, 1e10, true); }, [&](double x) { return absolute(fastAtan(x), std::atan(x)); } },
+        { "fastAsin", 1e-10, [&] { return uniform(-1, 1); }, [&](double x) { return absolute(fastAsin(x), std::asin(x)); } },
+        { "fastAcos", 1e-10, [&] { return uniform(-1, 1); }, [&](double x) { return absolute(fastAcos(x), std::acos(x)); } },
+        { "fastLog", 1e-15, [&] { return spread(1e-310, 1e300, false); }, [&](double x) { return logError(fastLog(x), std::log(x)); } },
+        { "fastLog2", 1e-15, [&] { return spread(1e-310, 1e300, false); }, [&](double x) { return logError(fastLog2(x), std::log2(x)); } },
+        { "fastExp2", 1e-15, [&] { return uniform(-1020, 1020); }, [&](double x) { return relative(fastExp2(x), std::exp2(x)); } },
+        // Subnormal results, in steps of the smallest one (2^-1074)
+        { "fastExp2", 1, [&] { return uniform(-1074, -1022); }, [&](double x) { return absolute(fastExp2(x), std::exp2(x)) / 0x1p-1074; } },
+        { "fastCbrt", 1e-13, [&] { return spread(1e-300, 1e300, true); }, [&](double x) { return relative(fastCbrt(x), std::cbrt(x)); } },
+    };
+    for (const Kernel& kernel : kernels) {
+        double worst{ 0 };
+        double worstAt{ 0 };
+        for (int i{ 0 }; i < samples; i++) {
+            double x{ kernel.input() };
+            double error{ kernel.error(x) };
+            if (!(error <= worst)) {
+                worst = error;
+                worstAt = x;
+            }
+        }
+        bool ok{ worst <= kernel.bound };
+        failed = failed || !ok;
+        std::cout << (ok ? "ok   " : "FAIL ") << kernel.name << ": worst error " << worst << " at " << std::setprecision(17)
+                  << worstAt << std::setprecision(6) << " (bound " << kernel.bound << ")\n";
+    }
+
+    // fastPow's bound depends on the exponent: 5e-16 * (1 + |exponent * log2(|base|)|)
+    double worst{ 0 };
+    double worstBase{ 0 };
+    double worstExponent{ 0 };
+    for (int i{ 0 }; i < samples; i++) {
+        double base{ spread(1e-3, 1e3, true) };
+        // Whole exponents (which negative bases need) a quarter of the time, 2 decimals otherwise
+        double exponent{ random() % 4 == 0 ? std::round(uniform(-100, 100)) : std::round(uniform(-100, 100) * 100) / 100 };
+        double exact{ std::pow(base, exponent) };
+        if (!(std::abs(exact) > 1e-300 && std::abs(exact) < 1e300)) continue;
+        double error{ relative(fastPow(base, exponent), exact) / (1 + std::abs(exponent * std::log2(std::abs(base)))) };
+        if (!(error <= worst)) {
+            worst = error;
+            worstBase = base;
+            worstExponent = exponent;
+        }
+    }
+    bool ok{ worst < 5e-16 };
+    failed = failed || !ok;
+    std::cout << (ok ? "ok   " : "FAIL ") << "fastPow: worst error / (1 + |exponent * log2(|base|)|) " << worst << " at "
+              << std::setprecision(17) << worstBase << "^" << worstExponent << std::setprecision(6) << " (bound 5e-16)\n";
+
+    // Graphs drawn in fast precision, which should only differ next to points within 1e-9 of 0
+    for (const char* equation : { "x^2+y^2-25", "SIN(x)-y", "x*y-3", "TAN(x)-y", "LN(ABS(x))-y", "x^3-2^y",
+                                          "ATAN(x*y)-0.5", "CBRT(x)+ASIN(y/8)-1", "LOG(x^2+1)*COS(y)-0.3" }) {
+        TreeItem tree{ };
+        std::string error{ };
+        if (!parseEquation(equation, tree, error)) {
+            std::cout << "FAIL " << equation << ": " << error << "\n";
+            failed = true;
+            continue;
+        }
+        Grid settings{ .stepX = 0.05, .stepY = 0.1, .precision = p::fast, .engine = e::grid };
+        PrecisionCheck check{ checkPrecision(tree, settings) };
+        bool same{ check.outsideBand == 0 };
+        failed = failed || !same;
+        std::cout << (same ? "ok   " : "FAIL ") << equation << ": " << check.inBand << " points drawn differently within "
+                  << check.band << " of 0, " << check.outsideBand << " elsewhere\n";
+    }
+    return failed ? 1 : 0;
+}
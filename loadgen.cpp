@@ -0,0 +1,91 @@
+// Load generator for the evaluation server (new --serve, see calculator/server.hpp).
+// Build: g++ loadgen.cpp -o loadgen -std=c++20 -pthread -O2
+// Run:   ./loadgen [socket path] [clients] [requests per client] [lanes per request] [--stop]
+//
+// Each client sends point requests for a few equations (and a grid request now and then),
+// then the latency seen by the clients and by the server are printed.
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "calculator/server.hpp"
+
+int main(int argc, char** argv) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    bool stop{ false };
+    std::erase_if(arguments, [&](const std::string& argument) {
+        if (argument == "--stop") stop = true;
+        return argument == "--stop";
+    });
+    std::string path{ arguments.size() > 0 ? arguments.at(0) : "calculator.sock" };
+    int clients{ arguments.size() > 1 ? std::stoi(arguments.at(1)) : 8 };
+    int requests{ arguments.size() > 2 ? std::stoi(arguments.at(2)) : 1000 };
+    std::uint32_t lanes{ arguments.size() > 3 ? (std::uint32_t)std::stoul(arguments.at(3)) : 64 };
+
+    const std::vector<std::string> equations{ "x^2+y^2-25", "SIN(x)-y", "x*y-3", "TAN(x)a-y" };
+
+    std::vector<std::vector<double>> latencies(clients);
+    std::vector<int> failures(clients, 0);
+    auto client{ [&](int id) {
+        int fd{ connectServer(path) };
+        if (fd < 0) {
+            failures[id] = requests;
+            return;
+        }
+        std::mt19937 random{ (unsigned int)id };
+        std::uniform_real_distribution<double> value{ -10, 10 };
+        for (int i{ 0 }; i < requests; i++) {
+            Request request{ };
+            request.equation = equations[(id + i) % equations.size()];
+            if (i % 50 == 49) {
+                request.kind = q::grid;
+            } else {
+                request.batch.size = lanes;
+                for (const char variable : { 'x', 'y', 'a' }) {
+                    std::vector<double>& values{ request.batch.varying[variable] };
+                    for (std::uint32_t lane{ 0 }; lane < lanes; lane++) values.push_back(value(random));
+                }
+            }
+            auto start{ std::chrono::steady_clock::now() };
+            Response response{ };
+            if (!askServer(fd, request, response) || !response.ok) {
+                failures[id]++;
+                continue;
+            }
+            latencies[id].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        ::close(fd);
+    } };
+
+    auto start{ std::chrono::steady_clock::now() };
+    std::vector<std::thread> threads{ };
+    for (int id{ 0 }; id < clients; id++) threads.emplace_back(client, id);
+    for (std::thread& thread : threads) thread.join();
+    double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+    std::vector<double> all{ };
+    int failed{ 0 };
+    for (int id{ 0 }; id < clients; id++) {
+        all.insert(all.end(), latencies[id].begin(), latencies[id].end());
+        failed += failures[id];
+    }
+    std::cout << clients << " clients, " << all.size() << " requests (" << failed << " failed) in " << seconds << "s, "
+              << all.size() / seconds << " requests/s\n"
+              << "Client latency (us): p50 " << percentile(all, 50) << ", p90 " << percentile(all, 90)
+              << ", p99 " << percentile(all, 99) << ", max " << percentile(all, 100) << "\n";
+
+    int fd{ connectServer(path) };
+    Response response{ };
+    if (fd < 0 || !askServer(fd, { .kind = q::stats }, response) || response.values.size() < 5) {
+        std::cout << "<!> [loadgen:0] Could not get stats from " << path << "\n";
+        return 1;
+    }
+    std::cout << "Server latency (us): p50 " << response.values[1] << ", p90 " << response.values[2]
+              << ", p99 " << response.values[3] << ", max " << response.values[4]
+              << " over " << response.values[0] << " requests\n";
+    if (stop) askServer(fd, { .kind = q::stop }, response);
+    ::close(fd);
+    return failed > 0 ? 1 : 0;
+}
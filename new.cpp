@@ -1,37 +1,88 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <algorithm>
 #include <regex>
-#include <stdexcept>
-#include <map>
-#include <cmath>
-#include <limits>
 #include <cmath>
-#ifndef SNUMBERS
-#include <numbers>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "calculator/autofit.hpp"
+#include "calculator/image.hpp"
+#include "calculator/integrate.hpp"
+#include "calculator/intersect.hpp"
+#include "calculator/library.hpp"
+#include "calculator/profile.hpp"
+#include "calculator/render.hpp"
+#include "calculator/sweep.hpp"
+#include "calculator/store.hpp"
+#ifndef _WIN32
+#include "calculator/server.hpp"
 #endif
-#ifdef SNUMBERS
-// Older g++ doesn't have <numbers>
-namespace std::numbers {
-    double pi{ 3.1415926535 };
-    double e{ 2.7182818284 };
+
+// Saved equations are kept here between runs
+const std::string savePath{ "saved-equations.bin" };
+
+// Everything the interactive calculator keeps between commands
+struct Session {
+    Grid grid{ .engine = e::roots }; // only drawn, so polynomials in y can be solved by their roots
+    TreeItem tree{ .function="0" }; // the last equation ("0" until there is one)
+    TreeItem yTree{ }; // m::parametric only: the last y(t) (tree is x(t))
+    std::string last{ "" }; // the last equation's text
+    std::vector<Save> savedEquations{ };
+    Definitions definitions{ };
+    Renderer renderer{ }; // graphs are solved and drawn in the background
+};
+
+// Parametric and polar curves are graphed along t, not over x and y
+bool isCurve(const Grid& grid) {
+    return grid.mode == m::parametric || grid.mode == m::polar;
 }
-#endif
 
-#include "calculator/def.hpp"
-#include "calculator/tokens.hpp"
-#include "calculator/tree.hpp"
-#include "calculator/solve.hpp"
-#include "calculator/grid.hpp"
+// What equations are entered after, in the current mode
+std::string equationPrefix(const Grid& grid) {
+    switch (grid.mode) {
+        case m::function: return "y = ";
+        case m::parametric: return "x, y = ";
+        case m::polar: return "r = ";
+        default: return "0 = ";
+    }
+}
+std::string equationPrompt(const Grid& grid) {
+    if (isCurve(grid)) return "Enter a curve: " + equationPrefix(grid);
+    if (grid.mode == m::function) return "Enter a function: " + equationPrefix(grid);
+    return "Enter an equation: " + equationPrefix(grid);
+}
+
+// What gets graphed for the last equation: x(t) and y(t) for parametric curves, otherwise just the one tree
+std::vector<TreeItem> graphedTrees(const Session& session) {
+    if (session.grid.mode == m::parametric) return { session.tree, session.yTree };
+    return { session.tree };
+}
+
+// The last equation as 0 = ..., for commands that solve every point of a grid
+TreeItem lastEquation(const Session& session) {
+    return session.grid.mode == m::function ? functionToEquation(session.tree) : session.tree;
+}
+
+// A saved equation as 0 = ..., for commands that graph saved equations together. Polar curves
+// can't be, so they print why and return false
+bool savedEquation(const Save& save, std::size_t slot, TreeItem& equation) {
+    if (save.mode == m::polar) {
+        std::cout << "Slot #" << slot << " is a polar curve, only equations and functions can be used here\n";
+        return false;
+    }
+    equation = save.mode == m::function ? functionToEquation(save.tree) : save.tree;
+    return true;
+}
 
 // Menu commands. Returns true on :quit, false otherwise
-bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, double arg = 0) {
-    struct Save{
-        std::string name;
-        TreeItem tree;
-    };
-    static std::vector<Save> savedEquations{ };
+bool menu(std::string query, Session& session, double arg = 0) {
+    Grid& grid{ session.grid };
+    TreeItem& tree{ session.tree };
+    const std::string& last{ session.last };
+    std::vector<Save>& savedEquations{ session.savedEquations };
 
     const std::regex rQueryName{ "^:[a-z]+" };
     std::smatch match;
@@ -49,10 +100,17 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
                   << "    endY:   " << grid.endY   << "\n"
                   << "    stepX:  " << grid.stepX  << "\n"
                   << "    stepY:  " << grid.stepY  << "\n"
-                  << "--\n";
+                  << "    precision: " << pAsString(grid.precision) << "\n"
+                  << "    mode:   " << mAsString(grid.mode) << "\n";
+        if (grid.mode == m::equation) std::cout << "    engine: " << eAsString(grid.engine) << "\n";
+        if (isCurve(grid)) {
+            std::cout << "    startT: " << grid.startT << "\n"
+                      << "    endT:   " << grid.endT << "\n";
+        }
+        std::cout << "--\n";
 
     } else if (name == ":wedit") {
-        menu(":window", grid, tree, last);
+        menu(":window", session);
         grid.startX = getNumber("Enter startX: ");
         grid.startY = getNumber("Enter startY: ");
 
@@ -73,26 +131,174 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
         grid.stepX = getNumber("Enter stepX: ");
         grid.stepY = getNumber("Enter stepY: ");
 
+        if (isCurve(grid)) {
+            grid.startT = getNumber("Enter startT: ");
+            double endT{ getNumber("Enter endT: ") };
+            while (grid.startT >= endT) {
+                std::cout << "endT must be greater than startT!\n";
+                endT = getNumber("Enter endT: ");
+            }
+            grid.endT = endT;
+        }
+
     } else if (name == ":solve" || name == ":v") {
         if (tree.function == "0") {
             std::cout << "Enter an equation first, then type :solve\n";
             return false;
         }
+        if (isCurve(grid)) {
+            double tValue{ getNumber("t value: ") };
+            Program program{ };
+            std::string error{ };
+            if (!compileEquations(graphedTrees(session), program, error)) std::cout << error << "\n";
+            CurvePoint point{ solveCurvePoints(program, grid, { tValue }).at(0) };
+            std::cout << "At t = " << tValue << ", x = " << point.x << ", y = " << point.y << "\n";
+            return false;
+        }
         double xValue{ getNumber("x value: ") };
-        double yValue{ getNumber("y value: ") };
+        double yValue{ grid.mode == m::function ? 0 : getNumber("y value: ") };
+
+        Program program{ };
+        std::string error{ };
+        if (!compileEquation(tree, program, error)) std::cout << error << "\n";
+        Variables variables{ };
+        variables['x'-'a'] = xValue;
+        variables['y'-'a'] = yValue;
+        std::vector<double> registers{ };
+        double result{ solvePoint(program, variables, registers) };
+
+        if (grid.mode == m::function) std::cout << "At x = " << xValue << ", y = " << result << "\n";
+        else std::cout << "Point (" << xValue << ", " << yValue << ") = " << result << "\n";
+
+    } else if (name == ":profile") {
+        if (tree.function == "0") {
+            std::cout << "Enter an equation first, then type :profile\n";
+            return false;
+        }
+        if (isCurve(grid)) {
+            std::cout << ":profile only works for equations and functions\n";
+            return false;
+        }
+        finishFrames(session.renderer);
+        TreeItem equation{ lastEquation(session) };
+        Program program{ compileTree(equation) };
+        std::cout << "Profiling 0 = " << (grid.mode == m::function ? "(" + last + ") - y" : last)
+                  << " over the window (" << countNodes(equation) << " tree nodes)\n";
+        printProfile(program, profileGrid(program, grid));
+
+    } else if (name == ":integrate") {
+        if (tree.function == "0") {
+            std::cout << "Enter an equation first, then type :integrate\n";
+            return false;
+        }
+        if (isCurve(grid)) {
+            std::cout << ":integrate only works for equations and functions\n";
+            return false;
+        }
+        Program program{ compileTree(tree) };
+        Quadrature quadrature{ .precision = grid.precision == p::fast ? p::fast : p::exact };
+        auto start{ std::chrono::steady_clock::now() };
+        Integral integral{ };
+        // Functions are integrated over x (from the window's startX to endX, or between two values),
+        // equations over the window
+        if (grid.mode == m::function) {
+            std::istringstream bounds{ query.substr(name.size()) };
+            double a{ grid.startX };
+            double b{ grid.endX };
+            if (bounds >> a && !(bounds >> b)) {
+                std::cout << "Usage: :integrate [from to]\n";
+                return false;
+            }
+            integral = integrate(program, a, b, quadrature);
+            std::cout << "Integral of " << last << " from x = " << a << " to " << b;
+        } else {
+            integral = integrateWindow(program, grid, quadrature);
+            std::cout << "Integral of " << last << " over x = " << grid.startX << " to " << grid.endX
+                      << ", y = " << grid.startY << " to " << grid.endY;
+        }
+        double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+        std::cout << " = " << std::setprecision(15) << integral.value << std::setprecision(6)
+                  << " (error about " << integral.error << ")\n"
+                  << "(I) " << integral.evaluations << " values in " << integral.pieces << " pieces, " << seconds * 1000 << "ms ("
+                  << integral.evaluations / std::max(seconds, 1e-9) / 1e6 << " million values/s)\n";
+        if (!integral.converged) {
+            std::cout << "(I) The integral didn't converge, so the error estimate can't be trusted: it may not be finite, or needs more values\n";
+        }
 
-        double result{ solveTree(tree, {{'x', xValue}, {'y', yValue}}) };
+    } else if (name == ":image") {
+        if (tree.function == "0") {
+            std::cout << "Enter an equation first, then type :image\n";
+            return false;
+        }
+        if (isCurve(grid)) {
+            std::cout << ":image only works for equations and functions\n";
+            return false;
+        }
+        std::istringstream words{ query.substr(name.size()) };
+        std::string path{ };
+        words >> path;
+        if (path.size() == 0) path = getLine("Enter image file (.png, .ppm or .pgm): ");
+        Image image{ };
+        if (!imageFormat(path, image.format)) {
+            std::cout << "Images must be .png, .ppm or .pgm files\n";
+            return false;
+        }
+        std::string word{ };
+        while (words >> word) {
+            if (word == "thick") image.thick = true;
+            else if (word == "noaxes") image.axes = false;
+            else if (!(std::istringstream{ word } >> image.width) || !(words >> image.height)) {
+                std::cout << "Usage: :image FILE [WIDTH HEIGHT] [thick] [noaxes]\n";
+                return false;
+            }
+        }
 
-        std::cout << "Point (" << xValue << ", " << yValue << ") = " << result << "\n";
+        Program program{ compileTree(lastEquation(session)) };
+        std::string error{ };
+        auto start{ std::chrono::steady_clock::now() };
+        if (!writeImage(program, grid, image, path, error)) {
+            std::cout << "<!> [menu:3] " << error << "\n";
+            return false;
+        }
+        std::cout << "(I) Wrote " << image.width << "x" << image.height << " image of " << equationPrefix(grid) << last
+                  << " to " << path << " in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s\n";
 
     } else if (name == ":save" || name == ":s") {
         if (tree.function == "0") {
             std::cout << "Enter an equation first, then type :save\n";
             return false;
         }
-        savedEquations.push_back({ last, tree });
+        if (grid.mode == m::parametric) {
+            std::cout << "Parametric curves can't be saved, only single equations\n";
+            return false;
+        }
+        savedEquations.push_back({ last, tree, grid.mode });
 
         std::cout << "Saved equation to slot #" << savedEquations.size()-1 << "\n";
+        if (!saveEquations(savePath, savedEquations)) {
+            std::cout << "<!> [menu:1] Could not write " << savePath << ", equation will be lost when the program ends\n";
+        }
+
+    } else if (name == ":def") {
+        std::string definition{ query.substr(name.size()) };
+        if (definition.find_first_not_of(' ') == std::string::npos) {
+            definition = getLine("Enter definition (eg HYP = SQRT(x^2+y^2) or SQ(v) = v^2): ");
+        }
+        std::string error{ };
+        if (!defineFunction(definition, session.definitions, error)) {
+            std::cout << "<!> [menu:2] " << error << "\n";
+            return false;
+        }
+        std::cout << "Defined " << definition.substr(definition.find_first_not_of(' ')) << "\n";
+
+    } else if (name == ":load") {
+        int reparsed{ 0 };
+        savedEquations = loadEquations(savePath, reparsed);
+        if (savedEquations.size() > 0) {
+            std::cout << "(I) Loaded " << savedEquations.size() << " saved equations from " << savePath;
+            if (reparsed > 0) std::cout << " (" << reparsed << " parsed again from source)";
+            std::cout << "\n";
+        }
 
     } else if (name == ":list" || name == ":ls") {
         if (savedEquations.size() == 0) {
@@ -100,7 +306,10 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
             return false;
         }
         for (std::size_t i{ 0 }; i < savedEquations.size(); i++) { 
-            std::cout << "#" << i << ": " << savedEquations.at(i).name << "\n";
+            const Save& save{ savedEquations.at(i) };
+            std::cout << "#" << i << ": " << save.name;
+            if (save.mode != m::equation) std::cout << " (" << mAsString(save.mode) << ")";
+            std::cout << "\n";
         }
 
 
@@ -109,11 +318,33 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
             std::cout << "No equation to graph.\n";
             return false;
         }
-        std::cout << "Graphing... 0 = " << last << "\n";
-        drawGrid(createGrid(tree, grid));
+        requestFrame(session.renderer, { graphedTrees(session), grid, "Graphing... " + equationPrefix(grid) + last });
+
+    } else if (name == ":autofit") {
+        if (tree.function == "0") {
+            std::cout << "Enter an equation first, then type :autofit\n";
+            return false;
+        }
+        auto start{ std::chrono::steady_clock::now() };
+        std::size_t solved{ 0 };
+        bool found{ isCurve(grid)
+            ? autofitCurve(compileTrees(graphedTrees(session)), grid, solved)
+            : autofitWindow(compileTree(lastEquation(session)), grid, 0.5, 0, solved) };
+        double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+        if (!found) {
+            std::cout << "Could not find the curve (solved " << solved << " points in " << seconds * 1000 << "ms)\n";
+            return false;
+        }
+        std::cout << "(I) Found the curve from " << solved << " points in " << seconds * 1000 << "ms\n";
+        menu(":window", session);
+        menu(":regraph", session);
 
     } else if (name == ":recall" || name == ":rs") {
-        menu(":list", grid, tree, last);
+        if (grid.mode == m::parametric) {
+            std::cout << "Saved equations can't be recalled as parametric curves, change :mode first\n";
+            return false;
+        }
+        menu(":list", session);
         if (savedEquations.size() == 0) { return false; } // Message already sent by :list
         std::size_t slot{ (std::size_t)getNumber("Enter slot #: ") };
         if (slot >= savedEquations.size()) {
@@ -121,18 +352,246 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
             return false;
         }
         Save recalled{ savedEquations.at(slot) };
+        if (recalled.mode != grid.mode) {
+            std::cout << "Slot #" << slot << " was saved in " << mAsString(recalled.mode) << " mode, change :mode first\n";
+            return false;
+        }
 
         tree = recalled.tree;
+        session.last = recalled.name;
+
+        menu(":regraph", session);
+
+    } else if (name == ":overlay" || name == ":ov") {
+        menu(":list", session);
+        if (savedEquations.size() == 0) { return false; } // Message already sent by :list
+        std::string slots{ getLine("Enter slot #s (eg 0 2 3), or all: ") };
+        if (slots == "all") {
+            slots = "";
+            for (std::size_t i{ 0 }; i < savedEquations.size(); i++) slots += std::to_string(i) + " ";
+        }
+
+        std::vector<TreeItem> trees{ };
+        std::stringstream stream{ slots };
+        std::size_t slot{ };
+        while (stream >> slot) {
+            if (slot >= savedEquations.size()) {
+                std::cout << "Slot #" << slot << " is empty.\n";
+                return false;
+            }
+            TreeItem equation{ };
+            if (!savedEquation(savedEquations.at(slot), slot, equation)) return false;
+            std::cout << overlayGlyph(trees.size()) << " = " << savedEquations.at(slot).name << "\n";
+            trees.push_back(equation);
+        }
+        if (trees.size() == 0) {
+            std::cout << "No slots to graph.\n";
+            return false;
+        }
+        finishFrames(session.renderer);
+        drawOverlay(createOverlay(trees, grid, true));
+
+    } else if (name == ":intersect") {
+        if (isCurve(grid)) {
+            std::cout << ":intersect only works for equations and functions\n";
+            return false;
+        }
+        std::istringstream slots{ query.substr(name.size()) };
+        std::size_t a{ };
+        std::size_t b{ };
+        if (!(slots >> a >> b)) {
+            menu(":list", session);
+            if (savedEquations.size() == 0) { return false; } // Message already sent by :list
+            a = (std::size_t)getNumber("Enter first slot #: ");
+            b = (std::size_t)getNumber("Enter second slot #: ");
+        }
+        if (a >= savedEquations.size() || b >= savedEquations.size()) {
+            std::cout << "Slot #" << (a >= savedEquations.size() ? a : b) << " is empty.\n";
+            return false;
+        }
+
+        std::vector<TreeItem> trees(2);
+        if (!savedEquation(savedEquations.at(a), a, trees[0]) || !savedEquation(savedEquations.at(b), b, trees[1])) return false;
+        auto start{ std::chrono::steady_clock::now() };
+        Intersections found{ findIntersections(compileTrees(trees), grid) };
+        double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+        std::cout << savedEquations.at(a).name << " and " << savedEquations.at(b).name << " cross at "
+                  << found.points.size() << (found.points.size() == 1 ? " point" : " points") << " in the window\n"
+                  << std::setprecision(10);
+        for (const auto& [x, y] : found.points) std::cout << "    (" << x << ", " << y << ")\n";
+        std::cout << std::setprecision(6) << "(I) Checked " << found.boxes << " boxes and solved " << found.solved
+                  << " values in " << seconds * 1000 << "ms\n";
+
+    } else if (name == ":sweep") {
+        if (tree.function == "0") {
+            std::cout << "Enter an equation first, then type :sweep\n";
+            return false;
+        }
+        if (isCurve(grid)) {
+            std::cout << ":sweep only works for equations and functions\n";
+            return false;
+        }
+        std::string letters{ getLine("Enter parameters to sweep (eg a b): ") };
+        std::vector<Sweep> sweeps{ };
+        for (const char variable : letters) {
+            if (variable == ' ') continue;
+            if (variable < 'a' || variable > 'z' || variable == 'x' || variable == 'y') {
+                std::cout << "Parameters must be lowercase letters other than x and y.\n";
+                return false;
+            }
+            Sweep sweep{ variable };
+            std::string letter{ variable };
+            sweep.start = getNumber("Enter " + letter + " start: ");
+            sweep.end = getNumber("Enter " + letter + " end: ");
+            while (sweep.start > sweep.end) {
+                std::cout << "end must not be less than start!\n";
+                sweep.end = getNumber("Enter " + letter + " end: ");
+            }
+            sweep.step = getNumber("Enter " + letter + " step: ");
+            while (sweep.step <= 0) {
+                std::cout << "step must be greater than 0!\n";
+                sweep.step = getNumber("Enter " + letter + " step: ");
+            }
+            sweeps.push_back(sweep);
+        }
+        if (sweeps.size() == 0) {
+            std::cout << "No parameters to sweep.\n";
+            return false;
+        }
+
+        finishFrames(session.renderer);
+        std::vector<Variables> frames{ sweepValues(sweeps) };
+        std::vector<Grid> grids{ createSweep(lastEquation(session), grid, frames, sweeps) };
+        for (std::size_t i{ 0 }; i < grids.size(); i++) {
+            std::cout << "Graphing... " << equationPrefix(grid) << last << "  with";
+            for (const Sweep& sweep : sweeps) {
+                std::cout << " " << sweep.variable << " = " << frames.at(i)[sweep.variable - 'a'];
+            }
+            std::cout << "\n";
+            drawGrid(grids.at(i));
+        }
+
+    } else if (name == ":precision") {
+        std::string mode{ query.substr(name.size()) };
+        mode.erase(0, mode.find_first_not_of(' '));
+        if (mode.size() == 0) {
+            std::cout << "Current precision: " << pAsString(grid.precision) << "\n";
+            mode = getLine("Enter precision (exact, fast, float, check): ");
+        }
+
+        if (mode == "exact") grid.precision = p::exact;
+        else if (mode == "fast") grid.precision = p::fast;
+        else if (mode == "float") grid.precision = p::single;
+        else if (mode == "check") {
+            if (tree.function == "0") {
+                std::cout << "Enter an equation first, then type :precision check\n";
+                return false;
+            }
+            if (isCurve(grid)) {
+                std::cout << ":precision check only works for equations and functions\n";
+                return false;
+            }
+            // Differences are only expected next to points so close to 0 that rounding can flip their sign
+            finishFrames(session.renderer);
+            PrecisionCheck check{ checkPrecision(lastEquation(session), grid) };
+            std::cout << "Points drawn differently with " << pAsString(check.precision) << " precision: "
+                      << check.inBand << " within " << check.band << " of 0, " << check.outsideBand << " elsewhere\n";
+            if (check.outsideBand > 0) std::cout << "<!> [menu:0] " << pAsString(check.precision) << " precision does not match exact precision\n";
+            return false;
+        } else {
+            std::cout << "Unknown precision " << mode << "\n";
+            return false;
+        }
+        std::cout << "Precision set to " << pAsString(grid.precision) << "\n";
+
+    } else if (name == ":mode") {
+        std::string mode{ query.substr(name.size()) };
+        mode.erase(0, mode.find_first_not_of(' '));
+        if (mode.size() == 0) {
+            std::cout << "Current mode: " << mAsString(grid.mode) << "\n";
+            mode = getLine("Enter mode (equation, function, parametric, polar): ");
+        }
+
+        if (mode == "equation") grid.mode = m::equation;
+        else if (mode == "function") grid.mode = m::function;
+        else if (mode == "parametric") grid.mode = m::parametric;
+        else if (mode == "polar") grid.mode = m::polar;
+        else {
+            std::cout << "Unknown mode " << mode << "\n";
+            return false;
+        }
+        std::cout << "Mode set to " << mAsString(grid.mode) << ", enter ";
+        switch (grid.mode) {
+            case m::function: std::cout << "functions as y = f(x)\n"; break;
+            case m::parametric: std::cout << "curves as x, y = x(t), y(t) (eg COS(3t), SIN(2t))\n"; break;
+            case m::polar: std::cout << "curves as r = r(t) (eg 1 + COS(t))\n"; break;
+            default: std::cout << "equations as 0 = ...\n";
+        }
+
+    } else if (name == ":engine") {
+        std::string engine{ query.substr(name.size()) };
+        engine.erase(0, engine.find_first_not_of(' '));
+        if (engine.size() == 0) {
+            std::cout << "Current engine: " << eAsString(grid.engine) << "\n";
+            engine = getLine("Enter engine (roots, grid, trace): ");
+        }
+
+        if (engine == "roots") grid.engine = e::roots;
+        else if (engine == "grid") grid.engine = e::grid;
+        else if (engine == "trace") grid.engine = e::trace;
+        else {
+            std::cout << "Unknown engine " << engine << "\n";
+            return false;
+        }
+        switch (grid.engine) {
+            case e::roots: std::cout << "Equations will be graphed by finding the roots in every column where they're polynomials in y, and by solving every point otherwise\n"; break;
+            case e::trace: std::cout << "Equations will be graphed by tracing along their curves\n"; break;
+            default: std::cout << "Equations will be graphed by solving every point\n";
+        }
 
-        menu(":regraph", grid, recalled.tree, recalled.name);
+    } else if (name == ":sampling") {
+        std::stringstream values{ query.substr(name.size()) };
+        int depth{ };
+        double most{ };
+        if (!(values >> depth >> most)) {
+            std::cout << "Current sampling: split up to " << grid.sampleDepth << " times, at most " << grid.sampleBudget << " values\n";
+            depth = (int)getNumber("Enter times a gap can be split (eg 20): ");
+            most = getNumber("Enter most values to solve per graph (eg 65536): ");
+        }
+        if (depth < 1 || most < 1) {
+            std::cout << "Both must be at least 1\n";
+            return false;
+        }
+        grid.sampleDepth = depth;
+        grid.sampleBudget = (std::size_t)most;
+        std::cout << "Functions split gaps up to " << grid.sampleDepth << " times, solving at most " << grid.sampleBudget << " values\n";
+
+    } else if (name == ":budget") {
+        std::string value{ query.substr(name.size()) };
+        value.erase(0, value.find_first_not_of(' '));
+        double ms{ };
+        if (value.size() == 0) {
+            std::cout << "Current budget: " << session.renderer.budget * 1000 << "ms\n";
+            ms = getNumber("Enter milliseconds until the first preview (0 to only draw finished graphs): ");
+        } else {
+            try {
+                ms = std::stod(value);
+            } catch (const std::exception&) {
+                std::cout << "Budget must be a number of milliseconds, not " << value << "\n";
+                return false;
+            }
+        }
+        session.renderer.budget = std::max(0.0, ms) / 1000;
+        if (session.renderer.budget > 0) std::cout << "Previews drawn after about " << session.renderer.budget * 1000 << "ms\n";
+        else std::cout << "Previews off, only finished graphs are drawn\n";
 
     } else if (name == ":zi") {
 
-        menu(":zoom", grid, tree, last, /* Arg */ 0.5);
+        menu(":zoom", session, /* Arg */ 0.5);
 
     } else if (name == ":zo") {
 
-        menu(":zoom", grid, tree, last, /* Arg */ 2);
+        menu(":zoom", session, /* Arg */ 2);
 
     } else if (name == ":zoom" || name == ":z") {
 
@@ -158,7 +617,7 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
         grid.stepY = grid.stepX*stepRatio;
 
         std::cout << level << "l, " << stepRatio << "r \n";
-        menu(":window", grid, tree, last);
+        menu(":window", session);
 
         if (grid.startX >= grid.endX || grid.startY >= grid.endY) {
             grid.endX += 1;
@@ -166,7 +625,7 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
             std::cout << "Too small of a zoom factor!\n";
         }
 
-        menu(":regraph", grid, tree, last);
+        menu(":regraph", session);
 
     } else if (name == ":center" || name == ":c") {
 
@@ -179,7 +638,7 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
         grid.startY = -(yDist);
         grid.endY   =  (yDist);
 
-        menu(":regraph", grid, tree, last);
+        menu(":regraph", session);
 
     } else if (name == ":r" || name == ":l" || name == ":u" || name == ":d") {
 
@@ -200,7 +659,7 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
             grid.endY -= yDist * 0.5;
         }
 
-        menu(":regraph", grid, tree, last);
+        menu(":regraph", session);
 
     } else if (name == ":help") {
 
@@ -209,9 +668,18 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
                   << "    :help - Help\n"
                   << "    :solve :v - Solve the last equation for a value\n"
                   << "    :regraph - Graph the same equation again\n"
-                  << "    :save :s - Save the last equation\n"
+                  << "    :profile - Show which parts of the last equation take the most time to graph\n"
+                  << "    :integrate [from to] - Integrate the last function over x (from startX to endX by default), or the last equation over the window\n"
+                  << "    :image FILE [WIDTH HEIGHT] [thick] [noaxes] - Draw the last equation to a .png, .ppm or .pgm image (default 1920x1080)\n"
+                  << "    :save :s - Save the last equation, with its mode (kept in saved-equations.bin)\n"
+                  << "    :load - Reload saved equations from saved-equations.bin\n"
                   << "    :list :ls - List saved equations\n"
-                  << "    :recall :rs - Recall a saved equation\n"
+                  << "    :recall :rs - Recall a saved equation (in the mode it was saved in)\n"
+                  << "    :overlay :ov - Graph several saved equations together\n"
+                  << "    :intersect [A B] - Find where saved equations A and B cross in the window\n"
+                  << "    :def NAME = ... - Define a function to use in equations, eg :def HYP = SQRT(x^2+y^2),\n"
+                  << "        or :def NAME(v) = ... for one that takes an argument, eg :def SQ(v) = v^2\n"
+                  << "    :sweep - Graph the last equation for a range of values of other variables (eg a, b)\n"
                   << "Graph window:\n"
                   << "    :zoom :z - Zoom to a specified amount at the center of the graph\n"
                   << "    :zi - Zoom in (*2) in the center of the graph\n"
@@ -220,6 +688,15 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
                   << "    :center :c - Center graph at (0, 0)\n"
                   << "    :window - Show graph window position\n"
                   << "    :wedit - Edit graph window position\n"
+                  << "    :autofit - Move and zoom the window to show the whole curve of the last equation\n"
+                  << "    :precision exact|fast|float - Use exact, fast (approximate) or float math for graphing\n"
+                  << "    :precision check - Check fast graphs match exact ones for the last equation\n"
+                  << "    :mode equation|function - Graph equations (0 = ...) or functions of x (y = ...), which solve much faster\n"
+                  << "    :engine roots|grid|trace - Graph equations by finding the roots in each column (polynomials in y only, the default),\n"
+                  << "        by solving every point, or by following their curves (solves far fewer points)\n"
+                  << "    :sampling [depth most] - How finely functions are solved where they bend (gaps split up to depth times, at most most values)\n"
+                  << "    :mode parametric|polar - Graph curves of t (x, y = ... or r = ...), the range of t is set with :wedit\n"
+                  << "    :budget [ms] - Time until a coarse preview of a slow graph is drawn (0 for no previews)\n"
                   << "Exit calculator:\n"
                   << "    :quit :q - Exit\n";
 
@@ -232,59 +709,141 @@ bool menu(std::string query, Grid& grid, TreeItem& tree, std::string last, doubl
     return false;
 }
 
-int main() {
-    bool verbose{ false };
-    std::cout << "GRAPHING CALCULATOR v2\n"
-              << "Enter an equation, or\n"
-              << ":help for help\n";
-
-    Grid userOptions{ };
-    TokenArr tokenized{ };
-    TreeItem tree{ .function="0" };
-    std::string last{ "" };
-
-    while (true) {
-        std::string equation{ getLine("Enter an equation: 0 = ") };
+// Throws away everything written to it (for --script --quiet)
+struct NullBuffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+// Prints how long each line of a script took, slowest last
+void printLatencies(std::vector<std::pair<std::string, double>> latencies) {
+    double total{ 0 };
+    std::cout << "(I) Latency of each command (ms, including drawing):\n";
+    for (const auto& [line, seconds] : latencies) {
+        std::cout << std::setw(10) << std::fixed << std::setprecision(2) << seconds * 1000 << "  " << line << "\n";
+        total += seconds;
+    }
+    if (latencies.size() == 0) return;
+    std::sort(latencies.begin(), latencies.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+    auto percentile{ [&](double p) { return latencies.at((std::size_t)(p * (latencies.size() - 1))).second * 1000; } };
+    std::cout << "(I) Ran " << latencies.size() << " commands in " << total * 1000 << "ms. Latency (ms): p50 " << percentile(0.5)
+              << ", p90 " << percentile(0.9) << ", max " << percentile(1) << " (" << latencies.back().first << ")\n";
+}
 
-        if (equation.starts_with(':')) {
-            if (menu(equation, userOptions, tree, last)) break;
-            continue;
+// Parses and graphs an equation (or x(t), y(t) for parametric curves) entered at the prompt
+void graphEquation(const std::string& equation, Session& session, bool verbose) {
+    const Grid& grid{ session.grid };
+
+    // Parametric curves are entered as x(t), y(t)
+    std::vector<std::string> parts{ equation };
+    if (grid.mode == m::parametric) {
+        std::size_t comma{ equation.find(',') };
+        if (comma == std::string::npos) {
+            std::cout << "<!> [main:3] Enter x(t) and y(t) separated by a comma, eg COS(3t), SIN(2t)\n";
+            return;
         }
-        // After menu(), so menu can see last
-        last = equation;
+        parts = { equation.substr(0, comma), equation.substr(comma + 1) };
+    }
+
+    std::string error{ };
+    std::vector<TreeItem> trees(parts.size());
+    Program program{ };
+    bool parsed{ true };
+    for (std::size_t i{ 0 }; i < parts.size() && parsed; i++) {
+        parsed = parseEquation(parts[i], trees[i], error, session.definitions);
+    }
+    if (!parsed) {
+        std::cout << error << "\n<!> [main:0] Parsing failed\n";
+        return;
+    }
+    // Unknown functions are only a warning here, they solve as 0
+    if (!compileEquations(trees, program, error)) std::cout << error << "\n";
+    unsigned int reads{ 0 };
+    for (const int root : program.roots) reads |= program.code[root].reads;
+    if (grid.mode == m::function && (reads & varBit('y')) != 0) {
+        std::cout << "(I) y is 0 in functions, use :mode equation to graph equations of x and y\n";
+    }
+    if (isCurve(grid) && (reads & (varBit('x') | varBit('y'))) != 0) {
+        std::cout << "(I) x and y are 0 in curves, use t instead\n";
+    }
+    session.tree = trees.at(0);
+    if (trees.size() > 1) session.yTree = trees.at(1);
+    session.last = equation;
+    if (verbose) printTree(session.tree);
+    if (verbose) printGrid(createGrid(session.tree, session.grid));
 
-        bool error{ false };
-        std::cout << "(I) Tokenizing equation...\n";
-        tokenized = tokenize(equation, error);
+    requestFrame(session.renderer, { trees, session.grid });
+}
 
-        std::cout << "(I) Cleaning equation...\n";
-        if (error || !clean(tokenized)) {
-            std::cout << "<!> [main:0] Parsing failed\n";
-            continue;
+int main(int argc, char** argv) {
+    bool verbose{ false };
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+
+#ifndef _WIN32
+    if (arguments.size() > 0 && arguments.at(0) == "--serve") {
+        Server server{ .path = arguments.size() > 1 ? arguments.at(1) : "calculator.sock" };
+        std::string error{ };
+        std::cout << "(I) Serving on " << server.path << "\n";
+        if (!serve(server, error)) {
+            std::cout << "<!> [main:2] " << error << "\n";
+            return 1;
         }
+        std::vector<double> stats{ latencyStats(server) };
+        std::cout << "(I) Solved " << stats.at(0) << " requests in " << server.batches << " batches. Latency (us): p50 " << stats.at(1)
+                  << ", p90 " << stats.at(2) << ", p99 " << stats.at(3) << ", max " << stats.at(4) << "\n";
+        return 0;
+    }
+#endif
 
-        if (verbose) {
-            for (const Token& tk : tokenized) {
-                printToken(tk);
-            }
+    // --script file [--quiet] runs the lines of a file as if they were typed, timing each one
+    bool scripted{ arguments.size() > 1 && arguments.at(0) == "--script" };
+    bool quiet{ scripted && arguments.size() > 2 && arguments.at(2) == "--quiet" };
+    std::ifstream script{ };
+    NullBuffer discard{ };
+    std::streambuf* input{ std::cin.rdbuf() };
+    std::streambuf* output{ std::cout.rdbuf() };
+    if (scripted) {
+        script.open(arguments.at(1));
+        if (!script) {
+            std::cout << "<!> [main:4] Could not read " << arguments.at(1) << "\n";
+            return 1;
         }
+        std::cin.rdbuf(script.rdbuf());
+        if (quiet) std::cout.rdbuf(&discard);
+    }
+    std::vector<std::pair<std::string, double>> latencies{ };
 
-        std::cout << "(I) Creating tree...\n";
-        tree = buildTree(tokenized);
-
-        if (verbose) printTree(tree);
+    std::cout << "GRAPHING CALCULATOR v2\n"
+              << "Enter an equation, or\n"
+              << ":help for help\n";
 
-        Grid g{ createGrid(tree, userOptions) };
-        if (verbose) printGrid(g);
-        drawGrid(g);
+    Session session{ };
+    session.renderer.draw = !quiet;
+    menu(":load", session);
+    startRenderer(session.renderer);
 
+    while (true) {
+        std::string line{ getLine(equationPrompt(session.grid)) };
+        if (line.size() == 0 && std::cin.eof()) break;
+
+        auto start{ std::chrono::steady_clock::now() };
+        bool quit{ line.starts_with(':') && menu(line, session) };
+        if (!line.starts_with(':')) graphEquation(line, session, verbose);
+        if (scripted) {
+            // Graphs are drawn in the background, so wait for them to count them
+            finishFrames(session.renderer);
+            latencies.push_back({ line, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() });
+        }
+        if (quit) break;
     }
-
-    // std::regex regex{ "\\(" };
-    // std::smatch match;
-    // std::regex_search(equation, match, regex);
-    // std::cout << "Match: " << match.str() << "\n";
+    // Draw the last graph before quitting
+    stopRenderer(session.renderer);
 
     std::cout << "\nDone!\n";
+
+    if (scripted) {
+        std::cin.rdbuf(input);
+        std::cout.rdbuf(output);
+        printLatencies(latencies);
+    }
     return 0;
 }